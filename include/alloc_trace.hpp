@@ -0,0 +1,346 @@
+#ifndef ALLOC_TRACE_HPP
+#define ALLOC_TRACE_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <execinfo.h>
+
+
+// Allocation tracing for the per-message hot path. Built only with -DITCH_ALLOC_TRACE (add -rdynamic
+// for symbol names in the call sites), which replaces the global operator new / delete. Otherwise the
+// scopes below are empty and nothing is hooked.
+//
+// Parser::apply() tags every allocation with the message type and the handler doing the work. The
+// first warmupMessages messages are counted separately, every allocation after that is steady state:
+// it is counted, its call site recorded and, with abortOnSteadyState, the run stops at the first one.
+
+enum class AllocationHandler : uint8_t {
+    None,           // outside apply(): decoding, writer threads, setup and teardown
+    Apply,          // order book and stock directory
+    Trades,
+    BBO,
+    Snapshots,
+    Incremental,
+    Count
+};
+
+inline const char* handlerName(AllocationHandler handler){
+    static constexpr const char* names[] = {"-", "apply", "trades", "bbo", "snapshots", "incremental"};
+    return names[size_t(handler)];
+}
+
+#ifdef ITCH_ALLOC_TRACE
+inline constexpr bool allocationTracingBuiltIn = true;
+#else
+inline constexpr bool allocationTracingBuiltIn = false;
+#endif
+
+struct AllocationSite{
+    char messageType = 0;
+    AllocationHandler handler = AllocationHandler::None;
+};
+
+
+class AllocationTracer{
+    static constexpr size_t handlerCount = size_t(AllocationHandler::Count);
+    static constexpr int maxFrames = 8;
+    // The hook itself and operator new, see onAllocation()
+    static constexpr int skippedFrames = 2;
+    static constexpr size_t callSiteSlots = 4096;
+
+    struct Counter{
+        std::atomic<uint64_t> allocations[2];
+        std::atomic<uint64_t> bytes[2];
+    };
+
+    // Filled from inside operator new, so a fixed table instead of a map.
+    struct CallSite{
+        uint64_t hash;
+        void* frames[maxFrames];
+        int depth;
+        AllocationSite site;
+        uint64_t allocations;
+        uint64_t bytes;
+    };
+
+    std::atomic<bool> enabled{false};
+    bool abortOnSteadyState = false;
+    uint64_t warmupMessages = 0;
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> frees{0};
+    Counter counters[256][handlerCount] = {};
+    std::mutex callSiteMutex;
+    CallSite callSites[callSiteSlots] = {};
+    uint64_t droppedCallSites = 0;
+
+    static inline thread_local AllocationSite current;
+    static inline thread_local bool insideHook = false;
+
+    void recordCallSite(void* const* frames, int depth, AllocationSite site, size_t size){
+        uint64_t hash = 1469598103934665603ULL ^ (uint64_t(uint8_t(site.messageType)) << 8) ^ uint64_t(site.handler);
+        for(int i = 0; i < depth; i++){
+            hash = (hash ^ uint64_t(reinterpret_cast<uintptr_t>(frames[i]))) * 1099511628211ULL;
+        }
+        hash |= 1;
+        std::lock_guard<std::mutex> lock(callSiteMutex);
+        for(size_t i = hash & (callSiteSlots - 1), probes = 0; probes < callSiteSlots / 2; i = (i + 1) & (callSiteSlots - 1), probes++){
+            CallSite& callSite = callSites[i];
+            if(callSite.hash == hash){
+                callSite.allocations++;
+                callSite.bytes += size;
+                return;
+            }
+            if(callSite.hash == 0){
+                callSite.hash = hash;
+                std::copy(frames, frames + depth, callSite.frames);
+                callSite.depth = depth;
+                callSite.site = site;
+                callSite.allocations = 1;
+                callSite.bytes = size;
+                return;
+            }
+        }
+        droppedCallSites++;
+    }
+
+    static void printFrames(void* const* frames, int depth, std::ostream& out){
+        char** symbols = backtrace_symbols(frames, depth);
+        for(int i = 0; i < depth; i++){
+            out << "        " << (symbols ? symbols[i] : "?") << "\n";
+        }
+        std::free(symbols);
+    }
+
+    public:
+    // Counts from now on. The first warmupMessages messages applied are warm-up.
+    void enable(uint64_t warmup, bool abortOnSteady){
+        warmupMessages = warmup;
+        abortOnSteadyState = abortOnSteady;
+        // The first backtrace() loads the unwinder, which allocates.
+        void* frames[1];
+        backtrace(frames, 1);
+        enabled = true;
+    }
+
+    void disable(){
+        enabled = false;
+    }
+
+    static AllocationSite site(){
+        return current;
+    }
+
+    static void setSite(AllocationSite site){
+        current = site;
+    }
+
+    void onMessage(){
+        messages.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    __attribute__((noinline)) void onAllocation(size_t size){
+        if(!enabled.load(std::memory_order_relaxed) || insideHook){
+            return;
+        }
+        insideHook = true;
+        AllocationSite site = current;
+        bool steady = messages.load(std::memory_order_relaxed) > warmupMessages;
+        Counter& counter = counters[uint8_t(site.messageType)][size_t(site.handler)];
+        counter.allocations[steady].fetch_add(1, std::memory_order_relaxed);
+        counter.bytes[steady].fetch_add(size, std::memory_order_relaxed);
+        if(steady){
+            void* frames[skippedFrames + maxFrames];
+            int depth = backtrace(frames, skippedFrames + maxFrames) - skippedFrames;
+            if(depth > 0){
+                recordCallSite(frames + skippedFrames, depth, site, size);
+            }
+            if(abortOnSteadyState && site.handler != AllocationHandler::None){
+                std::cerr << "[AllocationTracer] Steady state allocation of " << size << " bytes in handler "
+                          << handlerName(site.handler) << " for message type '" << site.messageType
+                          << "' after " << messages.load() << " messages:" << std::endl;
+                if(depth > 0){
+                    printFrames(frames + skippedFrames, depth, std::cerr);
+                }
+                std::abort();
+            }
+        }
+        insideHook = false;
+    }
+
+    void onFree(){
+        if(enabled.load(std::memory_order_relaxed) && !insideHook){
+            frees.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t steadyStateAllocations(){
+        uint64_t total = 0;
+        for(auto& byType : counters){
+            for(Counter& counter : byType){
+                total += counter.allocations[1].load();
+            }
+        }
+        return total;
+    }
+
+    void report(std::ostream& out){
+        bool wasEnabled = enabled.exchange(false);
+        out << "[AllocationTracer] " << messages.load() << " messages, warm-up " << warmupMessages << ", "
+            << frees.load() << " frees\n";
+        out << "type,handler,warmup_allocations,warmup_bytes,steady_allocations,steady_bytes,\n";
+        for(size_t type = 0; type < 256; type++){
+            for(size_t handler = 0; handler < handlerCount; handler++){
+                Counter& counter = counters[type][handler];
+                if(counter.allocations[0].load() == 0 && counter.allocations[1].load() == 0){
+                    continue;
+                }
+                out << (type ? std::string(1, char(type)) : std::string("-")) << "," << handlerName(AllocationHandler(handler)) << ","
+                    << counter.allocations[0].load() << "," << counter.bytes[0].load() << ","
+                    << counter.allocations[1].load() << "," << counter.bytes[1].load() << ",\n";
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(callSiteMutex);
+        std::vector<const CallSite*> sites;
+        for(const CallSite& callSite : callSites){
+            if(callSite.hash){
+                sites.push_back(&callSite);
+            }
+        }
+        std::sort(sites.begin(), sites.end(), [](const CallSite* a, const CallSite* b){ return a->allocations > b->allocations; });
+        out << "[AllocationTracer] " << sites.size() << " steady state call sites";
+        if(droppedCallSites){
+            out << " (" << droppedCallSites << " allocations at further sites not recorded)";
+        }
+        out << "\n";
+        for(const CallSite* callSite : sites){
+            out << "    " << callSite->allocations << " allocations, " << callSite->bytes << " bytes, type "
+                << (callSite->site.messageType ? callSite->site.messageType : '-') << ", handler " << handlerName(callSite->site.handler) << "\n";
+            printFrames(callSite->frames, callSite->depth, out);
+        }
+        out.flush();
+        enabled = wasEnabled;
+    }
+};
+
+inline AllocationTracer allocationTracer;
+
+
+// Tags the allocations of the enclosing block. The outermost scope with a message type counts a message.
+class AllocationScope{
+#ifdef ITCH_ALLOC_TRACE
+    AllocationSite saved;
+
+    public:
+    AllocationScope(char messageType, AllocationHandler handler) : saved(AllocationTracer::site()) {
+        if(saved.messageType == 0){
+            allocationTracer.onMessage();
+        }
+        AllocationTracer::setSite({messageType, handler});
+    }
+
+    explicit AllocationScope(AllocationHandler handler) : saved(AllocationTracer::site()) {
+        AllocationTracer::setSite({saved.messageType, handler});
+    }
+
+    ~AllocationScope(){
+        AllocationTracer::setSite(saved);
+    }
+#else
+    public:
+    AllocationScope(char, AllocationHandler) {}
+    explicit AllocationScope(AllocationHandler) {}
+#endif
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+};
+
+
+#ifdef ITCH_ALLOC_TRACE
+// Replaceable global allocation functions. They may only be defined once per program, main.cpp is
+// the only translation unit. noinline keeps the caller's frame right above operator new's.
+__attribute__((noinline)) void* operator new(std::size_t size){
+    void* p = std::malloc(size ? size : 1);
+    if(!p){
+        throw std::bad_alloc();
+    }
+    allocationTracer.onAllocation(size);
+    return p;
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size){
+    void* p = std::malloc(size ? size : 1);
+    if(!p){
+        throw std::bad_alloc();
+    }
+    allocationTracer.onAllocation(size);
+    return p;
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, std::align_val_t alignment){
+    size_t align = std::max(size_t(alignment), sizeof(void*));
+    void* p = nullptr;
+    if(posix_memalign(&p, align, size ? size : 1) != 0){
+        throw std::bad_alloc();
+    }
+    allocationTracer.onAllocation(size);
+    return p;
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size, std::align_val_t alignment){
+    size_t align = std::max(size_t(alignment), sizeof(void*));
+    void* p = nullptr;
+    if(posix_memalign(&p, align, size ? size : 1) != 0){
+        throw std::bad_alloc();
+    }
+    allocationTracer.onAllocation(size);
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if(p){
+        allocationTracer.onFree();
+    }
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    operator delete(p);
+}
+#endif
@@ -0,0 +1,77 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+#endif
+
+#pragma once
+
+
+#include <memory_resource>
+#include <cstddef>
+#include <sys/mman.h>
+
+
+// Upstream resource handing out whole huge pages straight from mmap.
+// Explicit huge pages (MAP_HUGETLB) are tried first, otherwise the mapping is marked
+// for transparent huge pages with madvise.
+class HugePageResource : public std::pmr::memory_resource{
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+    static size_t roundUp(size_t bytes){
+        return (bytes + hugePageSize - 1) & ~(hugePageSize - 1);
+    }
+
+    void* do_allocate(size_t bytes, size_t) override {
+        size_t size = roundUp(bytes);
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(mapping == MAP_FAILED){
+            mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(mapping == MAP_FAILED){
+                throw std::bad_alloc();
+            }
+            madvise(mapping, size, MADV_HUGEPAGE);
+        }
+        return mapping;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t) override {
+        munmap(p, roundUp(bytes));
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+
+// Arena for all of a Parser's containers. A pool of size classes on top of a monotonic buffer
+// reuses freed nodes and outgrown arrays, so memory follows the live book rather than every
+// allocation of the day. release() returns every chunk at once, so a Parser built on a ParserArena
+// skips destroying its containers node by node and the arena can be reused for the next file.
+class ParserArena : public std::pmr::memory_resource{
+    HugePageResource hugePages;
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::unsynchronized_pool_resource pool;
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        return pool.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        pool.deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    public:
+    ParserArena(size_t initialSize = 64 * 1024 * 1024) : arena(initialSize, &hugePages), pool(&arena) {}
+
+    ParserArena(const ParserArena&) = delete;
+    ParserArena& operator=(const ParserArena&) = delete;
+
+    void release(){
+        pool.release();
+        arena.release();
+    }
+};
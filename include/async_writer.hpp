@@ -0,0 +1,167 @@
+#ifndef ASYNC_WRITER_HPP
+#define ASYNC_WRITER_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include "utils.hpp"
+#include "spsc_ring.hpp"
+
+
+enum class OutputFormat{ CSV, Binary };
+
+// What push() does when the writer thread has fallen behind and the ring is full.
+enum class BackpressurePolicy{ Block, Drop };
+
+
+// Copies a symbol into a fixed, space padded 8 byte field (the ITCH stock field layout).
+inline void copySymbol(char (&field)[8], std::string_view name){
+    std::memset(field, ' ', sizeof(field));
+    std::memcpy(field, name.data(), std::min(name.size(), sizeof(field)));
+}
+
+inline std::string symbolString(const char (&field)[8]){
+    return rstrip(std::string(field, sizeof(field)));
+}
+
+
+// Fixed size records pushed by the engine. Each one knows its CSV header and row layout,
+// the binary format is the record itself.
+struct VWAPRecord{
+    char name[8];
+    double vwap;
+    uint16_t hour;
+    uint8_t reserved[6];
+
+    static const char* csvHeader(){
+        return "name,hour,vwap,\n";
+    }
+
+    void writeCSV(std::ostream& out) const {
+        out << symbolString(name) << "," << hour << "," << vwap << ",\n";
+    }
+};
+
+struct RawInfoRecord{
+    char name[8];
+    uint64_t timestamp;
+    uint64_t volume;
+    double price;
+
+    static const char* csvHeader(){
+        return "name,ts,vol,price,\n";
+    }
+
+    void writeCSV(std::ostream& out) const {
+        out << symbolString(name) << "," << timestamp << "," << volume << "," << price << ",\n";
+    }
+};
+
+
+// Asynchronous output sink. The engine thread only copies fixed size records into a lock-free ring,
+// a dedicated writer thread formats them (CSV or raw binary) and does all the file I/O.
+// close() (or the destructor) stops accepting records, drains the ring and joins the writer.
+template<typename Record>
+class AsyncWriter{
+    static constexpr size_t writerBatchSize = 1024;
+
+    SPSCRing<Record> ring;
+    OutputFormat format;
+    BackpressurePolicy policy;
+    std::ofstream outFile;
+    std::atomic<bool> closing{false};
+    std::atomic<uint64_t> droppedRecords{0};
+    uint64_t writtenRecords = 0;
+    std::thread writerThread;
+
+    void writeBatch(const Record* batch, size_t count){
+        if(format == OutputFormat::Binary){
+            outFile.write(reinterpret_cast<const char*>(batch), count * sizeof(Record));
+        }
+        else{
+            for(size_t i = 0; i < count; i++){
+                batch[i].writeCSV(outFile);
+            }
+        }
+        writtenRecords += count;
+    }
+
+    void writerLoop(){
+        std::vector<Record> batch(writerBatchSize);
+        while(true){
+            size_t count = ring.popBatch(batch.data(), batch.size());
+            if(count){
+                writeBatch(batch.data(), count);
+                continue;
+            }
+            if(closing.load(std::memory_order_acquire)){
+                // The producer has stopped, whatever is left in the ring is final.
+                while((count = ring.popBatch(batch.data(), batch.size()))){
+                    writeBatch(batch.data(), count);
+                }
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        outFile.flush();
+    }
+
+    public:
+    AsyncWriter(std::string filePath, OutputFormat format = OutputFormat::CSV, BackpressurePolicy policy = BackpressurePolicy::Block, size_t capacity = 1 << 16)
+        : ring(capacity), format(format), policy(policy) {
+        outFile.open(filePath, format == OutputFormat::Binary ? std::ios::binary : std::ios::out);
+        if(!outFile){
+            std::cerr << "Error opening the output file " << filePath << std::endl;
+        }
+        if(format == OutputFormat::CSV){
+            outFile << Record::csvHeader();
+        }
+        writerThread = std::thread(&AsyncWriter::writerLoop, this);
+    }
+
+    ~AsyncWriter(){
+        close();
+    }
+
+    // Returns false when the record was dropped under BackpressurePolicy::Drop.
+    bool push(const Record& record){
+        while(!ring.tryPush(record)){
+            if(policy == BackpressurePolicy::Drop){
+                droppedRecords.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    void close(){
+        if(writerThread.joinable()){
+            closing.store(true, std::memory_order_release);
+            writerThread.join();
+            if(droppedRecords.load()){
+                std::cerr << "[AsyncWriter] Dropped " << droppedRecords.load() << " record(s)" << std::endl;
+            }
+        }
+    }
+
+    uint64_t dropped() const {
+        return droppedRecords.load(std::memory_order_relaxed);
+    }
+
+    // Only meaningful after close().
+    uint64_t written() const {
+        return writtenRecords;
+    }
+};
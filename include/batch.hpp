@@ -0,0 +1,274 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include "parser.hpp"
+
+
+// A single ITCH day file scheduled by the BatchRunner.
+struct BatchJob{
+    std::string inputPath;
+    std::string day;
+    std::string outputPath;
+    uint64_t fileSize;
+    uint64_t memoryEstimate;
+};
+
+
+// Reads MemAvailable from /proc/meminfo, returns 0 when it cannot be determined.
+uint64_t availableMemoryBytes(){
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line, key;
+    uint64_t value;
+    while(std::getline(meminfo, line)){
+        std::istringstream fields(line);
+        if(fields >> key >> value && key == "MemAvailable:"){
+            return value * 1024;
+        }
+    }
+    return 0;
+}
+
+
+// Runs one independent Parser per ITCH day file on a pool of worker threads.
+// The pool is sized to the number of cores, and every job reserves an estimate of its
+// peak memory from a shared budget before it starts, so large days do not oversubscribe RAM.
+// Each day writes its own VWAP file and all days are merged into a single CSV at the end.
+class BatchRunner{
+    std::vector<BatchJob> jobs;
+    std::set<std::string> seenInputs;
+    std::set<std::string> days;
+    std::string outputDir;
+    std::string mergedVWAPFilePath;
+    size_t numWorkers;
+
+    // Peak resident memory of a Parser relative to the size of its input file.
+    double memoryPerInputByte = 1.0;
+    uint64_t memoryBudget;
+    uint64_t memoryInUse = 0;
+    size_t runningJobs = 0;
+    size_t nextJob = 0;
+    std::mutex schedulerMutex;
+    std::condition_variable memoryReleased;
+
+    // day -> name -> hour -> vwap
+    std::map<std::string, std::map<std::string, std::map<uint16_t, double>>> mergedVWAP;
+    std::mutex mergeMutex;
+
+    // Raw trades and open orders of every day, sorted by symbol and time, see enableRawExport()
+    std::unique_ptr<RawExportSorter> tradeExport, orderExport;
+    OutputFormat exportFormat = OutputFormat::CSV;
+
+    // Hourly aggregates of days seen before, see enableResultCache()
+    ResultCache* resultCache = nullptr;
+
+    // Sortable day of a file: Nasdaq's MMDDYYYY names become YYYYMMDD (see exportDay()) followed by the
+    // rest of the stem, other names keep their stem.
+    static std::string dayKey(const std::filesystem::path& path){
+        std::string stem = path.stem().string();
+        uint32_t day = exportDay(path.string());
+        return day ? std::to_string(day) + stem.substr(8) : stem;
+    }
+
+    void addInput(const std::filesystem::path& path){
+        if(!seenInputs.insert(std::filesystem::canonical(path).string()).second){
+            return;
+        }
+        BatchJob job;
+        job.inputPath = path.string();
+        // Files of the same day from different directories get numbered, so neither replaces the other's output.
+        std::string day = dayKey(path);
+        job.day = day;
+        for(int copy = 2; !days.insert(job.day).second; copy++){
+            job.day = day + "_" + std::to_string(copy);
+        }
+        if(job.day != day){
+            std::cerr << "[BatchRunner] " << path.string() << " has the same day as an earlier input, kept as " << job.day << std::endl;
+        }
+        job.outputPath = (std::filesystem::path(outputDir) / (job.day + "_vwap.csv")).string();
+        job.fileSize = std::filesystem::file_size(path);
+        job.memoryEstimate = uint64_t(job.fileSize * memoryPerInputByte);
+        jobs.push_back(job);
+    }
+
+    // Hands out the next job once its memory estimate fits into the budget.
+    // A job is always admitted when nothing else is running so oversized days still make progress.
+    bool acquireJob(BatchJob& job){
+        std::unique_lock<std::mutex> lock(schedulerMutex);
+        memoryReleased.wait(lock, [this](){
+            return nextJob >= jobs.size() || runningJobs == 0 ||
+                   memoryInUse + jobs[nextJob].memoryEstimate <= memoryBudget;
+        });
+        if(nextJob >= jobs.size()){
+            return false;
+        }
+        job = jobs[nextJob++];
+        memoryInUse += job.memoryEstimate;
+        runningJobs++;
+        return true;
+    }
+
+    void releaseJob(const BatchJob& job){
+        {
+            std::lock_guard<std::mutex> lock(schedulerMutex);
+            memoryInUse -= job.memoryEstimate;
+            runningJobs--;
+        }
+        memoryReleased.notify_all();
+    }
+
+    void runJob(const BatchJob& job, ParserArena& arena){
+        Parser parser = Parser(job.inputPath, job.outputPath, &arena);
+        // The raw export needs every trade, only the aggregates are cached.
+        std::string cacheKey = resultCache && !tradeExport ? resultCache->key(job.inputPath, parser.resultConfiguration()) : std::string();
+        std::vector<HourlyAggregate> aggregates;
+        if(!cacheKey.empty() && resultCache->loadRecords(cacheKey, "aggregates", aggregates)){
+            parser.loadAggregates(aggregates);
+            std::cout << "[batch] " << job.day << " from cache" << std::endl;
+        }
+        else{
+            parser.parse();
+            parser.processRunningVWAP();
+            if(!cacheKey.empty()){
+                resultCache->storeRecords(cacheKey, "aggregates", parser.hourlyAggregates());
+            }
+        }
+        if(tradeExport){
+            parser.exportRawInfo(*tradeExport, *orderExport, exportDay(job.inputPath));
+        }
+
+        const auto& stockMap = parser.getStockMap();
+        std::map<std::string, std::map<uint16_t, double>> dayVWAP;
+        for(auto& [stockLocate, hourlyVWAP] : parser.getVWAP()){
+            auto it = stockMap.find(stockLocate);
+            if(it != stockMap.end()){
+                dayVWAP[std::string(it->second)] = std::map<uint16_t, double>(hourlyVWAP.begin(), hourlyVWAP.end());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        mergedVWAP[job.day] = std::move(dayVWAP);
+        std::cout << "[batch] " << job.day << " done -> " << job.outputPath << std::endl;
+    }
+
+    // Every worker keeps one arena for all of its days and releases it in one shot after each day.
+    void worker(){
+        BatchJob job;
+        ParserArena arena;
+        while(acquireJob(job)){
+            runJob(job, arena);
+            arena.release();
+            releaseJob(job);
+        }
+    }
+
+    void writeMergedVWAP(){
+        std::ofstream mergedVWAPFile;
+        mergedVWAPFile.open(mergedVWAPFilePath);
+        mergedVWAPFile << "day,name,hour,vwap,\n";
+        for(auto& [day, dayVWAP] : mergedVWAP){
+            for(auto& [name, hourlyVWAP] : dayVWAP){
+                for(auto& [hour, vwap] : hourlyVWAP){
+                    mergedVWAPFile << day << "," << name << "," << hour << "," << vwap << ",\n";
+                }
+            }
+        }
+    }
+
+    public:
+    // Every input may either be an ITCH file or a directory whose regular files are all ITCH files.
+    BatchRunner(const std::vector<std::string>& inputs, std::string outputDir, size_t numWorkers = 0) : outputDir(outputDir), numWorkers(numWorkers) {
+        std::filesystem::create_directories(outputDir);
+        mergedVWAPFilePath = (std::filesystem::path(outputDir) / "merged_vwap.csv").string();
+
+        for(auto& input : inputs){
+            std::filesystem::path path(input);
+            if(std::filesystem::is_directory(path)){
+                std::vector<std::filesystem::path> dayFiles;
+                for(auto& entry : std::filesystem::directory_iterator(path)){
+                    if(entry.is_regular_file()){
+                        dayFiles.push_back(entry.path());
+                    }
+                }
+                std::sort(dayFiles.begin(), dayFiles.end());
+                for(auto& dayFile : dayFiles){
+                    addInput(dayFile);
+                }
+            }
+            else if(std::filesystem::is_regular_file(path)){
+                addInput(path);
+            }
+            else{
+                std::cerr << "[BatchRunner] Input " << input << " not found!" << std::endl;
+            }
+        }
+
+        // Largest days first, so a big file scheduled last doesn't become the tail of the run.
+        std::stable_sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b){
+            return a.fileSize > b.fileSize;
+        });
+
+        if(this->numWorkers == 0){
+            this->numWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        this->numWorkers = std::min(this->numWorkers, std::max<size_t>(jobs.size(), 1));
+
+        memoryBudget = uint64_t(availableMemoryBytes() * 0.8);
+        if(memoryBudget == 0){
+            memoryBudget = UINT64_MAX;
+        }
+    }
+
+    // Also writes raw_trades and open_orders of all days to the output directory, ordered by symbol, day
+    // and time. Each export keeps at most memoryBytes in memory and sorts the rest on disk.
+    void enableRawExport(size_t memoryBytes, OutputFormat format){
+        tradeExport = std::make_unique<RawExportSorter>((std::filesystem::path(outputDir) / "raw_trades").string(), memoryBytes);
+        orderExport = std::make_unique<RawExportSorter>((std::filesystem::path(outputDir) / "open_orders").string(), memoryBytes);
+        exportFormat = format;
+    }
+
+    // Days whose input and configuration match an earlier run are rebuilt from the cached hourly
+    // aggregates instead of being parsed. Not used together with the raw export.
+    void enableResultCache(ResultCache* cache){
+        resultCache = cache;
+    }
+
+    void run(){
+        std::cout << "[batch] " << jobs.size() << " file(s) on " << numWorkers << " worker(s)" << std::endl;
+
+        std::vector<std::thread> workers;
+        for(size_t i = 0; i < numWorkers; i++){
+            workers.emplace_back(&BatchRunner::worker, this);
+        }
+        for(auto& thread : workers){
+            thread.join();
+        }
+
+        writeMergedVWAP();
+        std::cout << "[batch] merged output -> " << mergedVWAPFilePath << std::endl;
+        if(tradeExport){
+            std::string extension = exportFormat == OutputFormat::Binary ? ".bin" : ".csv";
+            for(auto [name, sorter] : {std::make_pair("raw_trades", tradeExport.get()), std::make_pair("open_orders", orderExport.get())}){
+                std::string path = (std::filesystem::path(outputDir) / (name + extension)).string();
+                uint64_t records = sorter->finish(path, exportFormat);
+                std::cout << "[batch] " << records << " records -> " << path << std::endl;
+            }
+        }
+    }
+};
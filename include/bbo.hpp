@@ -0,0 +1,255 @@
+#ifndef BBO_HPP
+#define BBO_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <functional>
+
+
+// One top-of-book change as written to the quote tape. Prices are raw ITCH prices (1/10000 dollars),
+// a side without any resting order has price and shares 0.
+struct BBORecord{
+    uint64_t timestamp;
+    uint32_t bidPrice;
+    uint32_t askPrice;
+    uint32_t bidShares;
+    uint32_t askShares;
+    uint16_t stockLocate;
+    uint8_t reserved[6];
+};
+static_assert(sizeof(BBORecord) == 32, "BBORecord is written to disk as a fixed 32 byte record");
+
+
+// Tracks the full order book of both sides per stockLocate from the order level messages and emits
+// a BBORecord only when the best bid or offer actually changes.
+// With a conflation interval every symbol emits at most one record per interval; a change inside the
+// interval is held back and released with the latest top once the interval has elapsed.
+class BBOTracker{
+
+    struct BookOrder{
+        uint16_t stockLocate;
+        char side;
+        uint32_t price;
+        uint32_t shares;
+    };
+
+    struct SymbolBook{
+        std::map<uint32_t, uint64_t, std::greater<uint32_t>> bids;
+        std::map<uint32_t, uint64_t> asks;
+        BBORecord lastEmitted{};
+        bool emitted = false;
+        bool pending = false;
+    };
+
+    std::unordered_map<uint64_t, BookOrder> bookOrders;
+    std::vector<SymbolBook> books;
+
+    uint64_t conflationNanos;
+    // (release time, stockLocate) of symbols holding back a conflated update
+    std::priority_queue<std::pair<uint64_t, uint16_t>, std::vector<std::pair<uint64_t, uint16_t>>, std::greater<>> pendingReleases;
+
+    std::ofstream tapeFile;
+    std::vector<BBORecord> buffer;
+    size_t bufferSize = 0;
+    uint64_t recordsWritten = 0;
+
+    SymbolBook& book(uint16_t stockLocate){
+        if(stockLocate >= books.size()){
+            books.resize(size_t(stockLocate) + 1);
+        }
+        return books[stockLocate];
+    }
+
+    BBORecord currentTop(uint16_t stockLocate, SymbolBook& symbolBook) const {
+        BBORecord top{};
+        top.stockLocate = stockLocate;
+        if(!symbolBook.bids.empty()){
+            top.bidPrice = symbolBook.bids.begin()->first;
+            top.bidShares = uint32_t(std::min<uint64_t>(symbolBook.bids.begin()->second, UINT32_MAX));
+        }
+        if(!symbolBook.asks.empty()){
+            top.askPrice = symbolBook.asks.begin()->first;
+            top.askShares = uint32_t(std::min<uint64_t>(symbolBook.asks.begin()->second, UINT32_MAX));
+        }
+        return top;
+    }
+
+    static bool sameTop(const BBORecord& a, const BBORecord& b){
+        return a.bidPrice == b.bidPrice && a.bidShares == b.bidShares && a.askPrice == b.askPrice && a.askShares == b.askShares;
+    }
+
+    void emit(SymbolBook& symbolBook, BBORecord record, uint64_t timestamp){
+        record.timestamp = timestamp;
+        symbolBook.lastEmitted = record;
+        symbolBook.emitted = true;
+        buffer[bufferSize++] = record;
+        if(bufferSize == buffer.size()){
+            flushBuffer();
+        }
+    }
+
+    void flushBuffer(){
+        tapeFile.write(reinterpret_cast<const char*>(buffer.data()), bufferSize * sizeof(BBORecord));
+        recordsWritten += bufferSize;
+        bufferSize = 0;
+    }
+
+    // Releases every conflated update whose interval has elapsed by timestamp.
+    void releasePending(uint64_t timestamp){
+        while(!pendingReleases.empty() && pendingReleases.top().first <= timestamp){
+            auto [releaseTime, stockLocate] = pendingReleases.top();
+            pendingReleases.pop();
+            SymbolBook& symbolBook = books[stockLocate];
+            symbolBook.pending = false;
+            BBORecord top = currentTop(stockLocate, symbolBook);
+            if(!sameTop(top, symbolBook.lastEmitted)){
+                emit(symbolBook, top, releaseTime);
+            }
+        }
+    }
+
+    void checkTop(uint64_t timestamp, uint16_t stockLocate){
+        SymbolBook& symbolBook = books[stockLocate];
+        if(symbolBook.pending){
+            return;
+        }
+        BBORecord top = currentTop(stockLocate, symbolBook);
+        if(symbolBook.emitted && sameTop(top, symbolBook.lastEmitted)){
+            return;
+        }
+        if(conflationNanos == 0 || !symbolBook.emitted || timestamp >= symbolBook.lastEmitted.timestamp + conflationNanos){
+            emit(symbolBook, top, timestamp);
+        }
+        else{
+            symbolBook.pending = true;
+            pendingReleases.push({symbolBook.lastEmitted.timestamp + conflationNanos, stockLocate});
+        }
+    }
+
+    void addLevel(SymbolBook& symbolBook, char side, uint32_t price, uint32_t shares){
+        if(side == 'B'){
+            symbolBook.bids[price] += shares;
+        }
+        else{
+            symbolBook.asks[price] += shares;
+        }
+    }
+
+    void reduceLevel(SymbolBook& symbolBook, char side, uint32_t price, uint32_t shares){
+        if(side == 'B'){
+            auto level = symbolBook.bids.find(price);
+            if(level != symbolBook.bids.end() && (level->second -= std::min<uint64_t>(shares, level->second)) == 0){
+                symbolBook.bids.erase(level);
+            }
+        }
+        else{
+            auto level = symbolBook.asks.find(price);
+            if(level != symbolBook.asks.end() && (level->second -= std::min<uint64_t>(shares, level->second)) == 0){
+                symbolBook.asks.erase(level);
+            }
+        }
+    }
+
+    void reduceOrder(uint64_t timestamp, uint64_t orderRefNumber, uint32_t shares){
+        releasePending(timestamp);
+        auto it = bookOrders.find(orderRefNumber);
+        if(it == bookOrders.end()){
+            return;
+        }
+        BookOrder& order = it->second;
+        shares = std::min(shares, order.shares);
+        reduceLevel(books[order.stockLocate], order.side, order.price, shares);
+        order.shares -= shares;
+        uint16_t stockLocate = order.stockLocate;
+        if(order.shares == 0){
+            bookOrders.erase(it);
+        }
+        checkTop(timestamp, stockLocate);
+    }
+
+    public:
+    BBOTracker(std::string tapeFilePath, uint64_t conflationMicros = 0, size_t bufferRecords = 1 << 16) : conflationNanos(conflationMicros * 1000), buffer(bufferRecords) {
+        tapeFile.open(tapeFilePath, std::ios::binary);
+        if(!tapeFile){
+            std::cerr << "Error opening the BBO tape file " << tapeFilePath << std::endl;
+        }
+        bookOrders.reserve(1 << 20);
+    }
+
+    ~BBOTracker(){
+        finish();
+    }
+
+    // 'A' / 'F'
+    void onAdd(uint64_t timestamp, uint16_t stockLocate, uint64_t orderRefNumber, char side, uint32_t shares, uint32_t price){
+        releasePending(timestamp);
+        SymbolBook& symbolBook = book(stockLocate);
+        if(!bookOrders.emplace(orderRefNumber, BookOrder{stockLocate, side, price, shares}).second){
+            return;
+        }
+        addLevel(symbolBook, side, price, shares);
+        checkTop(timestamp, stockLocate);
+    }
+
+    // 'E' / 'C', an execution with a different price still removes the shares at the resting price.
+    void onExecute(uint64_t timestamp, uint64_t orderRefNumber, uint32_t executedShares){
+        reduceOrder(timestamp, orderRefNumber, executedShares);
+    }
+
+    // 'X'
+    void onCancel(uint64_t timestamp, uint64_t orderRefNumber, uint32_t cancelledShares){
+        reduceOrder(timestamp, orderRefNumber, cancelledShares);
+    }
+
+    // 'D'
+    void onDelete(uint64_t timestamp, uint64_t orderRefNumber){
+        reduceOrder(timestamp, orderRefNumber, UINT32_MAX);
+    }
+
+    // 'U', the replacement keeps the side and symbol of the original order.
+    void onReplace(uint64_t timestamp, uint64_t originalOrderRefNumber, uint64_t newOrderRefNumber, uint32_t shares, uint32_t price){
+        releasePending(timestamp);
+        auto it = bookOrders.find(originalOrderRefNumber);
+        if(it == bookOrders.end()){
+            return;
+        }
+        BookOrder order = it->second;
+        bookOrders.erase(it);
+        SymbolBook& symbolBook = books[order.stockLocate];
+        reduceLevel(symbolBook, order.side, order.price, order.shares);
+        if(bookOrders.emplace(newOrderRefNumber, BookOrder{order.stockLocate, order.side, price, shares}).second){
+            addLevel(symbolBook, order.side, price, shares);
+        }
+        checkTop(timestamp, order.stockLocate);
+    }
+
+    // Applies from the next update on; updates already held back keep their release time.
+    void setConflation(uint64_t conflationMicros){
+        conflationNanos = conflationMicros * 1000;
+    }
+
+    uint64_t conflationMicros() const {
+        return conflationNanos / 1000;
+    }
+
+    // Releases every held back update and writes out the buffer.
+    void finish(){
+        releasePending(UINT64_MAX);
+        if(bufferSize){
+            flushBuffer();
+        }
+        tapeFile.flush();
+    }
+
+    uint64_t recordCount() const {
+        return recordsWritten + bufferSize;
+    }
+};
@@ -0,0 +1,416 @@
+#ifndef BOOK_HISTORY_HPP
+#define BOOK_HISTORY_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <memory_resource>
+#include <algorithm>
+#include <cstring>
+#include "decoder.hpp"
+#include "mapped_file.hpp"
+#include "trade_tape.hpp"
+
+
+// One resting order as stored in a snapshot. Prices are raw ITCH prices (1/10000 dollars).
+struct BookOrder{
+    uint64_t orderRefNumber;
+    uint32_t price;
+    uint32_t shares;
+    char side;
+    uint8_t reserved[7];
+};
+
+// Snapshot of one symbol's book at timestamp, followed by the file offsets of the symbol's order
+// messages up to the next snapshot (varints, each relative to the previous one).
+struct SnapshotEntry{
+    uint64_t timestamp;
+    uint64_t ordersOffset;
+    uint64_t deltasOffset;
+    uint32_t orderCount;
+    uint32_t deltaCount;
+    uint32_t deltaBytes;
+    uint32_t reserved;
+};
+
+struct SnapshotDirectory{
+    char stock[8];
+    uint16_t stockLocate;
+    uint16_t reserved;
+    uint32_t entryCount;
+};
+
+struct SnapshotTrailer{
+    uint64_t directoryOffset;
+    uint64_t symbolCount;
+    char magic[8];
+};
+
+constexpr char snapshotMagic[8] = {'I', 'T', 'C', 'H', 'B', 'O', 'O', 'K'};
+
+
+// Order level book of a single symbol, shared by the snapshot writer and the as-of replay so both
+// apply 'A', 'F', 'E', 'C', 'X', 'D' and 'U' the same way.
+class SymbolBook{
+    std::unordered_map<uint64_t, BookOrder> orders;
+
+    void reduce(uint64_t orderRefNumber, uint64_t shares){
+        auto it = orders.find(orderRefNumber);
+        if(it == orders.end()){
+            return;
+        }
+        if(it->second.shares > shares){
+            it->second.shares -= uint32_t(shares);
+        }
+        else{
+            orders.erase(it);
+        }
+    }
+
+    public:
+    void apply(const Event& msg){
+        switch(msg.type){
+            case 'A':
+            case 'F':
+                orders[msg.orderRefNumber] = {msg.orderRefNumber, msg.price, uint32_t(msg.shares), msg.side, {}};
+                break;
+            case 'E':
+            case 'C':
+            case 'X':
+                reduce(msg.orderRefNumber, msg.shares);
+                break;
+            case 'D':
+                orders.erase(msg.orderRefNumber);
+                break;
+            case 'U': {
+                auto it = orders.find(msg.orderRefNumber);
+                if(it != orders.end()){
+                    char side = it->second.side;
+                    orders.erase(it);
+                    orders[msg.newOrderRefNumber] = {msg.newOrderRefNumber, msg.price, uint32_t(msg.shares), side, {}};
+                }
+                break;
+            }
+        }
+    }
+
+    void load(const BookOrder* snapshot, size_t count){
+        orders.clear();
+        orders.reserve(count);
+        for(size_t i = 0; i < count; i++){
+            orders[snapshot[i].orderRefNumber] = snapshot[i];
+        }
+    }
+
+    // Open orders sorted by order reference, so equal books produce equal snapshots.
+    std::vector<BookOrder> snapshot() const {
+        std::vector<BookOrder> sorted;
+        sorted.reserve(orders.size());
+        for(auto& [orderRefNumber, order] : orders){
+            sorted.push_back(order);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const BookOrder& a, const BookOrder& b){
+            return a.orderRefNumber < b.orderRefNumber;
+        });
+        return sorted;
+    }
+
+    size_t size() const {
+        return orders.size();
+    }
+
+    const std::unordered_map<uint64_t, BookOrder>& getOrders() const {
+        return orders;
+    }
+};
+
+
+// Writes the snapshot file during a normal parse() (attach with Parser::setBookSnapshots()).
+// At every interval boundary of market time, a symbol whose pending deltas outnumber both
+// minReplay and its open orders gets a fresh snapshot, so the snapshots never take more room than the
+// deltas they replace. A symbol busy enough to reach burstFactor times that within one interval gets
+// its snapshot right away. No as-of query therefore replays more than burstFactor * max(minReplay,
+// book size) messages, whatever the interval.
+// The directory of all entries goes to the end of the file in finish().
+class BookSnapshotWriter{
+    static constexpr size_t burstFactor = 4;
+
+    struct SymbolState{
+        SymbolBook book;
+        std::vector<SnapshotEntry> entries;
+        std::pmr::vector<uint8_t> deltas;
+        uint64_t lastOffset = 0;
+        uint32_t deltaCount = 0;
+        bool dirty = false;
+        char stock[8] = {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+        bool listed = false;
+    };
+
+    std::ofstream outFile;
+    uint64_t filePosition = 0;
+    uint64_t intervalNanos;
+    size_t minReplay;
+    uint64_t nextBoundary = 0;
+    uint64_t lastTimestamp = 0;
+    std::vector<SymbolState> states;
+    std::vector<uint16_t> dirtySymbols;
+    bool finished = false;
+
+    void write(const void* data, size_t bytes){
+        outFile.write(static_cast<const char*>(data), bytes);
+        filePosition += bytes;
+    }
+
+    void openEntry(SymbolState& state, uint64_t timestamp){
+        std::vector<BookOrder> orders = state.book.snapshot();
+        SnapshotEntry entry{};
+        entry.timestamp = timestamp;
+        entry.ordersOffset = filePosition;
+        entry.orderCount = uint32_t(orders.size());
+        write(orders.data(), orders.size() * sizeof(BookOrder));
+        state.entries.push_back(entry);
+        state.lastOffset = 0;
+        state.deltaCount = 0;
+    }
+
+    void closeEntry(SymbolState& state){
+        SnapshotEntry& entry = state.entries.back();
+        entry.deltasOffset = filePosition;
+        entry.deltaCount = state.deltaCount;
+        entry.deltaBytes = uint32_t(state.deltas.size());
+        write(state.deltas.data(), state.deltas.size());
+        state.deltas.clear();
+    }
+
+    void checkpoint(){
+        for(uint16_t stockLocate : dirtySymbols){
+            SymbolState& state = states[stockLocate];
+            state.dirty = false;
+            if(state.deltaCount >= std::max(minReplay, state.book.size())){
+                closeEntry(state);
+                openEntry(state, lastTimestamp);
+            }
+        }
+        dirtySymbols.clear();
+    }
+
+    static bool isOrderMessage(char type){
+        return type == 'A' || type == 'F' || type == 'E' || type == 'C' || type == 'X' || type == 'D' || type == 'U';
+    }
+
+    public:
+    BookSnapshotWriter(std::string filePath, uint64_t intervalMicros = 1000000, size_t minReplay = 256)
+        : outFile(filePath, std::ios::binary), intervalNanos(std::max<uint64_t>(1, intervalMicros) * 1000),
+          minReplay(minReplay), states(size_t(UINT16_MAX) + 1) {
+        if(!outFile){
+            std::cerr << "Error opening the book snapshot file " << filePath << std::endl;
+        }
+        write(snapshotMagic, sizeof(snapshotMagic));
+    }
+
+    ~BookSnapshotWriter(){
+        finish();
+    }
+
+    void onEvent(const Event& msg){
+        if(msg.type == 'R'){
+            std::memcpy(states[msg.stockLocate].stock, msg.stock, sizeof(msg.stock));
+            states[msg.stockLocate].listed = true;
+            return;
+        }
+        if(!isOrderMessage(msg.type)){
+            return;
+        }
+        if(msg.timestamp >= nextBoundary){
+            checkpoint();
+            nextBoundary = (msg.timestamp / intervalNanos + 1) * intervalNanos;
+        }
+        lastTimestamp = msg.timestamp;
+
+        SymbolState& state = states[msg.stockLocate];
+        if(state.entries.empty()){
+            openEntry(state, 0);
+        }
+        writeVarint(state.deltas, msg.offset - state.lastOffset);
+        state.lastOffset = msg.offset;
+        state.deltaCount++;
+        if(!state.dirty){
+            state.dirty = true;
+            dirtySymbols.push_back(msg.stockLocate);
+        }
+        state.book.apply(msg);
+        if(state.deltaCount >= burstFactor * std::max(minReplay, state.book.size())){
+            closeEntry(state);
+            openEntry(state, msg.timestamp);
+        }
+    }
+
+    // Flushes the pending deltas and writes the directory and trailer.
+    void finish(){
+        if(finished){
+            return;
+        }
+        finished = true;
+        std::vector<uint16_t> symbols;
+        for(size_t stockLocate = 0; stockLocate < states.size(); stockLocate++){
+            SymbolState& state = states[stockLocate];
+            if(!state.entries.empty()){
+                closeEntry(state);
+            }
+            if(!state.entries.empty() || state.listed){
+                symbols.push_back(uint16_t(stockLocate));
+            }
+        }
+
+        SnapshotTrailer trailer{};
+        trailer.directoryOffset = filePosition;
+        trailer.symbolCount = symbols.size();
+        std::memcpy(trailer.magic, snapshotMagic, sizeof(snapshotMagic));
+        for(uint16_t stockLocate : symbols){
+            SymbolState& state = states[stockLocate];
+            SnapshotDirectory directory{};
+            std::memcpy(directory.stock, state.stock, sizeof(directory.stock));
+            directory.stockLocate = stockLocate;
+            directory.entryCount = uint32_t(state.entries.size());
+            write(&directory, sizeof(directory));
+            write(state.entries.data(), state.entries.size() * sizeof(SnapshotEntry));
+        }
+        write(&trailer, sizeof(trailer));
+        outFile.close();
+        states.clear();
+    }
+};
+
+
+struct BookLevel{
+    uint32_t price;
+    uint64_t shares;
+    uint32_t orders;
+};
+
+struct BookAsOf{
+    uint64_t timestamp;
+    std::vector<BookLevel> bids;  // best (highest) first
+    std::vector<BookLevel> asks;  // best (lowest) first
+};
+
+
+// As-of queries over a snapshot file and the day file it was written from. A query loads the last
+// snapshot of the symbol at or before the requested time and replays only that symbol's order
+// messages after it, decoding them straight from the mapped day file.
+class BookHistory{
+    MappedFile snapshots;
+    MappedFile itch;
+    std::unordered_map<uint16_t, std::pair<const SnapshotEntry*, uint32_t>> entries;
+    std::unordered_map<std::string, uint16_t> symbolLocates;
+
+    static std::vector<BookLevel> levels(const std::map<uint32_t, BookLevel>& byPrice, bool descending, size_t depth){
+        std::vector<BookLevel> result;
+        auto add = [&result, depth](const BookLevel& level){
+            if(depth == 0 || result.size() < depth){
+                result.push_back(level);
+            }
+        };
+        if(descending){
+            for(auto it = byPrice.rbegin(); it != byPrice.rend(); it++){
+                add(it->second);
+            }
+        }
+        else{
+            for(auto& [price, level] : byPrice){
+                add(level);
+            }
+        }
+        return result;
+    }
+
+    public:
+    BookHistory(const std::string& snapshotFilePath, const std::string& itchFilePath) : snapshots(snapshotFilePath), itch(itchFilePath) {
+        if(snapshots.size() < sizeof(snapshotMagic) + sizeof(SnapshotTrailer)){
+            std::cerr << "[BookHistory] " << snapshotFilePath << " is not a snapshot file" << std::endl;
+            return;
+        }
+        SnapshotTrailer trailer;
+        std::memcpy(&trailer, snapshots.data() + snapshots.size() - sizeof(trailer), sizeof(trailer));
+        if(std::memcmp(trailer.magic, snapshotMagic, sizeof(snapshotMagic)) != 0){
+            std::cerr << "[BookHistory] " << snapshotFilePath << " is incomplete (no trailer)" << std::endl;
+            return;
+        }
+        const char* p = snapshots.data() + trailer.directoryOffset;
+        for(uint64_t i = 0; i < trailer.symbolCount; i++){
+            SnapshotDirectory directory;
+            std::memcpy(&directory, p, sizeof(directory));
+            p += sizeof(directory);
+            entries[directory.stockLocate] = {reinterpret_cast<const SnapshotEntry*>(p), directory.entryCount};
+            symbolLocates[rstrip(std::string(directory.stock, sizeof(directory.stock)))] = directory.stockLocate;
+            p += directory.entryCount * sizeof(SnapshotEntry);
+        }
+    }
+
+    // Returns the locate of a symbol, or 0 when the symbol is unknown (locates start at 1).
+    uint16_t locate(const std::string& symbol) const {
+        auto it = symbolLocates.find(symbol);
+        return it == symbolLocates.end() ? 0 : it->second;
+    }
+
+    // Book of stockLocate after every message with a timestamp up to and including timestamp.
+    // depth limits the number of price levels per side, 0 returns all of them.
+    BookAsOf asOf(uint16_t stockLocate, uint64_t timestamp, size_t depth = 0) const {
+        BookAsOf result;
+        result.timestamp = timestamp;
+        auto found = entries.find(stockLocate);
+        if(found == entries.end() || found->second.second == 0){
+            return result;
+        }
+        const SnapshotEntry* first = found->second.first;
+        const SnapshotEntry* last = first + found->second.second;
+        const SnapshotEntry* entry = std::upper_bound(first, last, timestamp, [](uint64_t ts, const SnapshotEntry& e){
+            return ts < e.timestamp;
+        });
+        if(entry == first){
+            return result;
+        }
+        entry--;
+
+        SymbolBook book;
+        std::vector<BookOrder> orders(entry->orderCount);
+        std::memcpy(orders.data(), snapshots.data() + entry->ordersOffset, orders.size() * sizeof(BookOrder));
+        book.load(orders.data(), orders.size());
+
+        const uint8_t* delta = reinterpret_cast<const uint8_t*>(snapshots.data() + entry->deltasOffset);
+        uint64_t offset = 0;
+        Event msg;
+        for(uint32_t i = 0; i < entry->deltaCount; i++){
+            offset += readVarint(delta);
+            if(offset + 2 >= itch.size()){
+                break;
+            }
+            size_t length = size_t(loadBigEndian<2>(itch.data() + offset));
+            if(offset + 2 + length > itch.size() || !decodeEvent(itch.data() + offset + 2, length, msg)){
+                break;
+            }
+            if(msg.timestamp > timestamp){
+                break;
+            }
+            book.apply(msg);
+        }
+
+        std::map<uint32_t, BookLevel> bids, asks;
+        for(auto& [orderRefNumber, order] : book.getOrders()){
+            BookLevel& level = (order.side == 'B' ? bids : asks)[order.price];
+            level.price = order.price;
+            level.shares += order.shares;
+            level.orders++;
+        }
+        result.bids = levels(bids, true, depth);
+        result.asks = levels(asks, false, depth);
+        return result;
+    }
+};
@@ -0,0 +1,153 @@
+#ifndef CATCH_UP_HPP
+#define CATCH_UP_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <ctime>
+#include "message.hpp"
+
+
+// Lag of a follow() run behind its feed, and the catch-up mode it switches into when the lag grows.
+//
+// Lag is measured as the bytes written to the file but not yet read (queue depth) and, optionally, as
+// the feed time of the last message behind the local wall clock. ITCH timestamps count from midnight in
+// the exchange's time zone, so the feed time lag needs TZ to match it (e.g. TZ=America/New_York); it is
+// off by default and meaningless for files replayed on another day.
+//
+// In catch-up mode the Parser skips the message types that neither the book nor the VWAP depend on,
+// before decoding them, conflates the BBO tape and holds back live snapshots. The mode ends once both
+// lags are below an eighth of their thresholds, so a feed hovering around a threshold does not flap.
+class CatchUpMonitor{
+    // Checking the file size and the clock on every message would cost more than the message.
+    static constexpr uint32_t messagesPerCheck = 4096;
+    static constexpr uint64_t exitDivisor = 8;
+
+    uint64_t enterBacklogBytes;
+    uint64_t enterLagNanos;
+    uint64_t conflationMicros;
+    bool skippable[256] = {};
+
+    bool catchingUp = false;
+    uint32_t sinceCheck = 0;
+    uint64_t backlogBytes = 0;
+    uint64_t lagNanos = 0;
+    std::chrono::steady_clock::time_point enteredAt;
+    uint64_t episodeMessages = 0;
+    uint64_t episodeSkipped = 0;
+
+    uint64_t episodes = 0;
+    uint64_t totalSkipped = 0;
+    std::chrono::steady_clock::duration totalCatchUpTime{0};
+
+    // Local wall clock time since midnight, in nanoseconds.
+    static uint64_t wallClockOfDay(){
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        tm local;
+        localtime_r(&now.tv_sec, &local);
+        uint64_t seconds = uint64_t(local.tm_hour) * 3600 + uint64_t(local.tm_min) * 60 + uint64_t(local.tm_sec);
+        return seconds * 1000000000ULL + uint64_t(now.tv_nsec);
+    }
+
+    bool overThreshold(uint64_t divisor) const {
+        return backlogBytes > enterBacklogBytes / divisor || (enterLagNanos && lagNanos > enterLagNanos / divisor);
+    }
+
+    std::string lagText() const {
+        std::string text = std::to_string(backlogBytes >> 20) + " MB behind";
+        if(enterLagNanos){
+            text += ", " + std::to_string(lagNanos / 1000000) + " ms of feed time";
+        }
+        return text;
+    }
+
+    public:
+    // Messages the order book and the hourly VWAP need: the stock directory, every order and trade
+    // message, and the system events ('S' carries the end of messages).
+    static bool essentialType(char type){
+        switch(type){
+            case 'S': case 'R':
+            case 'A': case 'F': case 'E': case 'C': case 'X': case 'D': case 'U':
+            case 'P': case 'Q': case 'B':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // enterLagMillis 0 watches the backlog only. conflationMicros is the BBO conflation interval while catching up.
+    CatchUpMonitor(uint64_t enterBacklogBytes = 64 << 20, uint64_t enterLagMillis = 0, uint64_t conflationMicros = 1000000)
+        : enterBacklogBytes(enterBacklogBytes), enterLagNanos(enterLagMillis * 1000000), conflationMicros(conflationMicros) {
+        for(auto& [type, size] : packet_sizes){
+            skippable[uint8_t(type)] = !essentialType(type);
+        }
+    }
+
+    bool active() const {
+        return catchingUp;
+    }
+
+    uint64_t bboConflationMicros() const {
+        return conflationMicros;
+    }
+
+    // True for a message type the Parser may drop right now.
+    bool skips(char type) const {
+        return catchingUp && skippable[uint8_t(type)];
+    }
+
+    void onSkipped(){
+        episodeSkipped++;
+    }
+
+    // Counts a message and tells whether the lag is due for another check().
+    bool due(){
+        episodeMessages += catchingUp;
+        if(++sinceCheck < messagesPerCheck){
+            return false;
+        }
+        sinceCheck = 0;
+        return true;
+    }
+
+    // Updates the lag from the unread bytes and the feed time of the last message. Returns true when
+    // the mode changed; the transition is reported on std::cerr.
+    bool check(uint64_t unreadBytes, uint64_t feedTimestamp){
+        backlogBytes = unreadBytes;
+        if(enterLagNanos){
+            uint64_t wallClock = wallClockOfDay();
+            lagNanos = wallClock > feedTimestamp ? wallClock - feedTimestamp : 0;
+        }
+        if(!catchingUp && overThreshold(1)){
+            catchingUp = true;
+            enteredAt = std::chrono::steady_clock::now();
+            episodeMessages = 0;
+            episodeSkipped = 0;
+            episodes++;
+            std::cerr << "[CatchUp] " << lagText() << ", skipping non-essential messages and conflating output" << std::endl;
+            return true;
+        }
+        if(catchingUp && !overThreshold(exitDivisor)){
+            catchingUp = false;
+            auto elapsed = std::chrono::steady_clock::now() - enteredAt;
+            totalCatchUpTime += elapsed;
+            totalSkipped += episodeSkipped;
+            std::cerr << "[CatchUp] Caught up after " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms ("
+                      << lagText() << "), " << episodeMessages - episodeSkipped << " messages applied, " << episodeSkipped << " skipped" << std::endl;
+            return true;
+        }
+        return false;
+    }
+
+    void report(std::ostream& out) const {
+        uint64_t skipped = totalSkipped + (catchingUp ? episodeSkipped : 0);
+        auto elapsed = totalCatchUpTime + (catchingUp ? std::chrono::steady_clock::now() - enteredAt : std::chrono::steady_clock::duration(0));
+        out << "[CatchUp] " << episodes << " catch-up episode(s), " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
+            << " ms in catch-up mode, " << skipped << " messages skipped" << (catchingUp ? ", still behind at the end" : "") << std::endl;
+    }
+};
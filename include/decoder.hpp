@@ -0,0 +1,384 @@
+#ifndef DECODER_HPP
+#define DECODER_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <array>
+#include <tuple>
+#include "utils.hpp"
+#include "message.hpp"
+#include "spsc_ring.hpp"
+
+
+// One decoded ITCH message, normalized to the fields the engine applies. Fields a message type
+// does not carry are left zero. indicator holds the System Event code ('S'), the printable flag ('C')
+// or the cross type ('Q'); stock is only filled for Stock Directory ('R') messages, which carry no
+// order reference. offset is the file position of the message's length prefix.
+struct Event{
+    uint64_t timestamp;
+    uint64_t orderRefNumber;         // original order for 'U'
+    union{
+        uint64_t newOrderRefNumber;  // 'U'
+        char stock[8];               // 'R'
+    };
+    uint64_t matchNumber;
+    uint64_t shares;                 // executed / cancelled shares for 'E', 'C', 'X'
+    uint64_t offset;
+    uint32_t price;                  // raw price (1/10000 dollars), execution price for 'C'
+    uint16_t stockLocate;
+    char type;
+    char side;
+    char indicator;
+    uint8_t reserved[7];
+};
+
+static_assert(sizeof(Event) == 64, "Event should fill exactly one cache line");
+
+
+// Only the stock of a Stock Directory message is decoded.
+using StockDirectoryStock = std::tuple_element_t<3, std::remove_const_t<decltype(Schema<StockDirectory>::fields)>>;
+
+// Bytes decodeEvent() reads from a message of each type, type byte included: its schema size, the end of
+// the stock for Stock Directory, the common header for types outside ITCH 5.0.
+template<typename... Messages>
+constexpr std::array<uint8_t, 256> decodedSizes(std::tuple<Messages...>*){
+    std::array<uint8_t, 256> sizes{};
+    for(auto& size : sizes){
+        size = 11;
+    }
+    ((sizes[uint8_t(Schema<Messages>::type)] = uint8_t(Schema<Messages>::size)), ...);
+    sizes[uint8_t('R')] = uint8_t(StockDirectoryStock::offset + StockDirectoryStock::width);
+    return sizes;
+}
+
+inline constexpr std::array<uint8_t, 256> decodedBytes = decodedSizes(static_cast<MessageTypes*>(nullptr));
+
+// Fills event from one message (starting at its type byte) of length bytes. The loads are generated
+// from the message schemas, so they are constant-offset loads of only the fields copied here. Every
+// message gets type, locate and timestamp. A frame too short for its type is rejected before any field
+// is read: event is left zero (type 0, which apply() skips) and false is returned.
+inline bool decodeEvent(const char* message, size_t length, Event& event){
+    std::memset(&event, 0, sizeof(Event));
+    if(length == 0 || length < decodedBytes[uint8_t(message[0])]){
+        return false;
+    }
+    event.type = message[0];
+    event.stockLocate = uint16_t(loadBigEndian<2>(message + 1));
+    event.timestamp = loadBigEndian<6>(message + 5);
+
+    switch(event.type){
+        case 'S': {
+            SystemEvent msg;
+            decodeMessage(message, msg);
+            event.indicator = msg.eventCode;
+            break;
+        }
+        case 'R': {
+            StockDirectory msg;
+            StockDirectoryStock::decode(message, msg);
+            std::memcpy(event.stock, msg.stock, sizeof(event.stock));
+            break;
+        }
+        case 'A':
+        case 'F': {
+            AddOrderNoMPID msg;
+            decodeMessage(message, msg);
+            event.orderRefNumber = msg.orderRefNumber;
+            event.side = msg.buySellIndicator;
+            event.shares = msg.shares;
+            event.price = msg.priceRaw;
+            break;
+        }
+        case 'E': {
+            OrderExecuted msg;
+            decodeMessage(message, msg);
+            event.orderRefNumber = msg.orderRefNumber;
+            event.shares = msg.executedShares;
+            event.matchNumber = msg.matchNumber;
+            break;
+        }
+        case 'C': {
+            OrderExecutedWithPrice msg;
+            decodeMessage(message, msg);
+            event.orderRefNumber = msg.orderRefNumber;
+            event.shares = msg.executedShares;
+            event.matchNumber = msg.matchNumber;
+            event.indicator = msg.printable;
+            event.price = msg.executionPriceRaw;
+            break;
+        }
+        case 'X': {
+            OrderCancel msg;
+            decodeMessage(message, msg);
+            event.orderRefNumber = msg.orderRefNumber;
+            event.shares = msg.cancelledShares;
+            break;
+        }
+        case 'D': {
+            OrderDelete msg;
+            decodeMessage(message, msg);
+            event.orderRefNumber = msg.orderRefNumber;
+            break;
+        }
+        case 'U': {
+            OrderReplace msg;
+            decodeMessage(message, msg);
+            event.orderRefNumber = msg.originalOrderRefNumber;
+            event.newOrderRefNumber = msg.newOrderRefNumber;
+            event.shares = msg.shares;
+            event.price = msg.priceRaw;
+            break;
+        }
+        case 'P': {
+            NonCrossTrade msg;
+            decodeMessage(message, msg);
+            event.orderRefNumber = msg.orderRefNumber;
+            event.side = msg.buySellIndicator;
+            event.shares = msg.shares;
+            event.price = msg.priceRaw;
+            event.matchNumber = msg.matchNumber;
+            break;
+        }
+        case 'Q': {
+            CrossTrade msg;
+            decodeMessage(message, msg);
+            event.shares = msg.shares;
+            event.price = msg.crossPriceRaw;
+            event.matchNumber = msg.matchNumber;
+            event.indicator = msg.crossType;
+            break;
+        }
+        case 'B': {
+            BrokenTrade msg;
+            decodeMessage(message, msg);
+            event.matchNumber = msg.matchNumber;
+            break;
+        }
+    }
+    return true;
+}
+
+
+// Reads a file in large blocks and frames it by the 2 byte length in front of every message.
+class FrameReader{
+    std::ifstream file;
+    std::vector<char> buffer;
+    size_t begin = 0, end = 0;
+    // File position of buffer[0], and of the last message returned.
+    uint64_t bufferOffset = 0, lastOffset = 0;
+    bool emptyFrameFound = false;
+
+    // Moves the unread tail to the front and reads more, false when fewer than bytes are left.
+    bool fill(size_t bytes){
+        if(end - begin >= bytes){
+            return true;
+        }
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        bufferOffset += begin;
+        end -= begin;
+        begin = 0;
+        if(file){
+            file.read(buffer.data() + end, buffer.size() - end);
+            end += size_t(file.gcount());
+        }
+        return end - begin >= bytes;
+    }
+
+    public:
+    FrameReader(const std::string& filePath, size_t bufferSize = 1 << 22) : file(filePath, std::ios::binary), buffer(bufferSize) {}
+
+    bool good() const {
+        return bool(file) || end > begin;
+    }
+
+    // Returns the next message (type byte first) and sets its length, nullptr at the end of the file.
+    // A truncated message at the end of the file is left unread. Framing stops for good at a length 0
+    // frame, see emptyFrame().
+    const char* next(size_t& length){
+        if(!fill(2)){
+            return nullptr;
+        }
+        length = size_t(loadBigEndian<2>(buffer.data() + begin));
+        if(length == 0){
+            emptyFrameFound = true;
+            return nullptr;
+        }
+        if(!fill(2 + length)){
+            return nullptr;
+        }
+        const char* message = buffer.data() + begin + 2;
+        lastOffset = bufferOffset + begin;
+        begin += 2 + length;
+        return message;
+    }
+
+    // True once next() stopped at a length 0 frame: the framing is lost, more bytes will not help.
+    bool emptyFrame() const {
+        return emptyFrameFound;
+    }
+
+    // File position of the length prefix next() stopped at.
+    uint64_t position() const {
+        return bufferOffset + begin;
+    }
+
+    // Lets next() read past the end of file reached earlier, for files that are still growing.
+    // A partial message at the old end stays buffered and is completed by the new bytes.
+    void resume(){
+        file.clear();
+    }
+
+    // File position of the length prefix of the message next() returned last.
+    uint64_t messageOffset() const {
+        return lastOffset;
+    }
+};
+
+
+// Two stage decode/apply pipeline. A decode thread frames and decodes the file into fixed size
+// batches of Events and hands them over through a lock-free ring; the consuming thread applies whole
+// batches, so the two stages only synchronize once per batch. Batches are preallocated and travel
+// back to the decoder through a second ring once applied.
+class DecodePipeline{
+    static constexpr uint32_t noBatch = UINT32_MAX;
+
+    struct EventBatch{
+        std::vector<Event> events;
+        size_t count = 0;
+    };
+
+    std::vector<EventBatch> batches;
+    SPSCRing<uint32_t> decoded, recycled;
+    std::atomic<bool> finished{false};
+    std::atomic<bool> stopping{false};
+    std::thread decoderThread;
+    uint64_t decodedEvents = 0;
+    // Batch the consumer is reading with next(), and its read position.
+    uint32_t currentBatch = noBatch;
+    size_t position = 0;
+
+    void decoderLoop(std::string filePath, size_t batchSize){
+        FrameReader reader(filePath);
+        if(!reader.good()){
+            std::cerr << "Error loading the binary file " << filePath << std::endl;
+        }
+        size_t length;
+        const char* message = reader.next(length);
+        while(message){
+            uint32_t index;
+            while(!recycled.popBatch(&index, 1)){
+                if(stopping.load(std::memory_order_relaxed)){
+                    finished.store(true, std::memory_order_release);
+                    return;
+                }
+                std::this_thread::yield();
+            }
+            EventBatch& batch = batches[index];
+            batch.count = 0;
+            while(message && batch.count < batchSize){
+                Event& event = batch.events[batch.count++];
+                decodeEvent(message, length, event);
+                event.offset = reader.messageOffset();
+                message = reader.next(length);
+            }
+            decodedEvents += batch.count;
+            while(!decoded.tryPush(index)){
+                std::this_thread::yield();
+            }
+        }
+        finished.store(true, std::memory_order_release);
+    }
+
+    // Next decoded batch, nullptr once the decoder is done and the ring is drained.
+    EventBatch* nextBatch(){
+        uint32_t index;
+        while(!decoded.popBatch(&index, 1)){
+            // The ring is only known to stay empty when it still is after the decoder finished.
+            bool done = finished.load(std::memory_order_acquire);
+            if(decoded.popBatch(&index, 1)){
+                break;
+            }
+            if(done){
+                if(decoderThread.joinable()){
+                    decoderThread.join();
+                }
+                return nullptr;
+            }
+            std::this_thread::yield();
+        }
+        currentBatch = index;
+        return &batches[index];
+    }
+
+    void releaseBatch(){
+        if(currentBatch != noBatch){
+            recycled.tryPush(currentBatch);
+            currentBatch = noBatch;
+        }
+    }
+
+    public:
+    DecodePipeline(std::string filePath, size_t batchSize = 4096, size_t numBatches = 16)
+        : batches(numBatches), decoded(numBatches), recycled(numBatches) {
+        for(uint32_t i = 0; i < numBatches; i++){
+            batches[i].events.resize(batchSize);
+            recycled.tryPush(i);
+        }
+        decoderThread = std::thread(&DecodePipeline::decoderLoop, this, filePath, batchSize);
+    }
+
+    // Also safe before the file is consumed, the decoder stops at its next batch.
+    ~DecodePipeline(){
+        stopping.store(true, std::memory_order_relaxed);
+        if(decoderThread.joinable()){
+            decoderThread.join();
+        }
+    }
+
+    DecodePipeline(const DecodePipeline&) = delete;
+    DecodePipeline& operator=(const DecodePipeline&) = delete;
+
+    // Calls apply on every Event of the file in order, on the calling thread.
+    template<typename F>
+    void run(F apply){
+        while(EventBatch* batch = nextBatch()){
+            for(size_t i = 0; i < batch->count; i++){
+                apply(batch->events[i]);
+            }
+            releaseBatch();
+        }
+    }
+
+    // Pull interface for consumers that interleave several pipelines: the next Event of the file,
+    // nullptr at its end. The Event stays valid until the following call.
+    const Event* next(){
+        if(currentBatch != noBatch && position < batches[currentBatch].count){
+            return &batches[currentBatch].events[position++];
+        }
+        releaseBatch();
+        EventBatch* batch = nextBatch();
+        while(batch && batch->count == 0){
+            releaseBatch();
+            batch = nextBatch();
+        }
+        if(!batch){
+            return nullptr;
+        }
+        position = 1;
+        return &batch->events[0];
+    }
+
+    // Only meaningful once the file is consumed.
+    uint64_t eventCount() const {
+        return decodedEvents;
+    }
+};
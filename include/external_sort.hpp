@@ -0,0 +1,338 @@
+#ifndef EXTERNAL_SORT_HPP
+#define EXTERNAL_SORT_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <filesystem>
+#include <type_traits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "async_writer.hpp"
+#include "mapped_file.hpp"
+
+
+// Sorts more fixed size records than fit in memory. Records are pushed into a buffer of half the
+// memory budget; a full buffer is sorted and written out as a run file while producers fill the
+// other half. finish() merges the runs, and the buffer still in memory, with one k-way merge per
+// thread over its own key range, so the output is written by several threads at sequential speed.
+// The sort is stable: records that compare equal keep the order they were pushed in.
+template<typename Record, typename Less>
+class ExternalSorter{
+    static_assert(std::is_trivially_copyable<Record>::value, "ExternalSorter records must be trivially copyable");
+    static constexpr size_t mergeBufferRecords = (1 << 20) / sizeof(Record);
+    static constexpr size_t samplesPerPartition = 64;
+
+    struct Run{
+        const Record* data;
+        size_t count;
+    };
+
+    std::string runPathPrefix;
+    size_t capacity;
+    Less less;
+    std::vector<Record> buffer;
+    std::vector<std::string> runPaths;
+    uint64_t pushedRecords = 0;
+    std::mutex bufferMutex;
+    // Held while a full buffer is sorted and written, so at most two buffers are in memory.
+    std::mutex spillMutex;
+
+    bool writeRun(std::vector<Record>& records, const std::string& path){
+        std::stable_sort(records.begin(), records.end(), less);
+        std::ofstream run(path, std::ios::binary);
+        run.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(Record)));
+        if(!run){
+            std::cerr << "[ExternalSorter] Writing run " << path << " failed" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Merges the [begin, end) slice of every run in key order, ties in run order, into write().
+    template<typename Write>
+    void mergeSlices(const std::vector<Run>& runs, const std::vector<size_t>& begins, const std::vector<size_t>& ends, Write write) const {
+        struct Cursor{
+            const Record* next;
+            const Record* end;
+            size_t run;
+        };
+        auto after = [this](const Cursor& a, const Cursor& b){
+            if(less(*b.next, *a.next)){
+                return true;
+            }
+            return !less(*a.next, *b.next) && a.run > b.run;
+        };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)> heap(after);
+        for(size_t run = 0; run < runs.size(); run++){
+            if(begins[run] < ends[run]){
+                heap.push({runs[run].data + begins[run], runs[run].data + ends[run], run});
+            }
+        }
+        std::vector<Record> out;
+        out.reserve(mergeBufferRecords);
+        while(!heap.empty()){
+            Cursor cursor = heap.top();
+            heap.pop();
+            out.push_back(*cursor.next++);
+            if(cursor.next != cursor.end){
+                heap.push(cursor);
+            }
+            if(out.size() == mergeBufferRecords){
+                write(out);
+                out.clear();
+            }
+        }
+        write(out);
+    }
+
+    static bool appendFile(int outFd, const std::string& path){
+        int inFd = open(path.c_str(), O_RDONLY);
+        if(inFd < 0){
+            return false;
+        }
+        ssize_t copied;
+        while((copied = copy_file_range(inFd, nullptr, outFd, nullptr, 1 << 30, 0)) > 0){
+        }
+        if(copied < 0){
+            // Kernels or filesystems without copy_file_range. Both file offsets have advanced past
+            // whatever it did copy, so read/write continues from there.
+            std::vector<char> chunk(1 << 20);
+            ssize_t bytes;
+            while((bytes = read(inFd, chunk.data(), chunk.size())) > 0){
+                if(write(outFd, chunk.data(), size_t(bytes)) != bytes){
+                    close(inFd);
+                    return false;
+                }
+            }
+            copied = bytes;
+        }
+        close(inFd);
+        return copied == 0;
+    }
+
+    public:
+    // Run files are named runPathPrefix.N.run and removed by finish().
+    ExternalSorter(std::string runPathPrefix, size_t memoryBudgetBytes, Less less = Less())
+        : runPathPrefix(runPathPrefix), capacity(std::max<size_t>(memoryBudgetBytes / 2 / sizeof(Record), 1)), less(less) {
+        buffer.reserve(capacity);
+    }
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    ~ExternalSorter(){
+        for(auto& path : runPaths){
+            std::filesystem::remove(path);
+        }
+    }
+
+    // Safe to call from several threads.
+    void push(const Record* records, size_t count){
+        while(count > 0){
+            std::unique_lock<std::mutex> lock(bufferMutex);
+            size_t taken = std::min(count, capacity - buffer.size());
+            buffer.insert(buffer.end(), records, records + taken);
+            pushedRecords += taken;
+            records += taken;
+            count -= taken;
+            if(buffer.size() < capacity){
+                continue;
+            }
+            std::vector<Record> full;
+            full.swap(buffer);
+            std::string path = runPathPrefix + "." + std::to_string(runPaths.size()) + ".run";
+            runPaths.push_back(path);
+            std::lock_guard<std::mutex> spill(spillMutex);
+            buffer.reserve(capacity);
+            lock.unlock();
+            writeRun(full, path);
+        }
+    }
+
+    uint64_t size() const {
+        return pushedRecords;
+    }
+
+    // Writes every record pushed, sorted, to outputPath as CSV (with the record's header) or as the raw
+    // records. numThreads merges run in parallel (0: one per core). Returns the number of records written.
+    uint64_t finish(const std::string& outputPath, OutputFormat format, size_t numThreads = 0){
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        std::lock_guard<std::mutex> spill(spillMutex);
+        std::stable_sort(buffer.begin(), buffer.end(), less);
+
+        std::vector<std::unique_ptr<MappedFile>> files;
+        std::vector<Run> runs;
+        for(auto& path : runPaths){
+            files.push_back(std::make_unique<MappedFile>(path));
+            files.back()->adviseSequential();
+            runs.push_back({reinterpret_cast<const Record*>(files.back()->data()), files.back()->size() / sizeof(Record)});
+        }
+        // The buffer is the newest run, it merges from memory.
+        runs.push_back({buffer.data(), buffer.size()});
+        uint64_t total = 0;
+        for(const Run& run : runs){
+            total += run.count;
+        }
+
+        if(numThreads == 0){
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        size_t partitions = std::max<size_t>(1, std::min<size_t>(numThreads, total / mergeBufferRecords));
+
+        // Splitters from evenly spaced samples of every run; all runs cut at the same keys, so equal
+        // records land in the same partition and the merge stays stable.
+        std::vector<Record> samples;
+        for(const Run& run : runs){
+            size_t step = std::max<size_t>(run.count / (samplesPerPartition * partitions), 1);
+            for(size_t i = step / 2; i < run.count; i += step){
+                samples.push_back(run.data[i]);
+            }
+        }
+        std::sort(samples.begin(), samples.end(), less);
+        std::vector<std::vector<size_t>> cuts(partitions + 1, std::vector<size_t>(runs.size()));
+        for(size_t run = 0; run < runs.size(); run++){
+            cuts[partitions][run] = runs[run].count;
+        }
+        for(size_t p = 1; p < partitions; p++){
+            const Record& splitter = samples[p * samples.size() / partitions];
+            for(size_t run = 0; run < runs.size(); run++){
+                cuts[p][run] = size_t(std::lower_bound(runs[run].data, runs[run].data + runs[run].count, splitter, less) - runs[run].data);
+            }
+        }
+
+        std::vector<uint64_t> firstRecord(partitions + 1, 0);
+        for(size_t p = 0; p < partitions; p++){
+            firstRecord[p + 1] = firstRecord[p];
+            for(size_t run = 0; run < runs.size(); run++){
+                firstRecord[p + 1] += cuts[p + 1][run] - cuts[p][run];
+            }
+        }
+
+        bool ok = true;
+        std::mutex okMutex;
+        auto fail = [&ok, &okMutex](const std::string& message){
+            std::lock_guard<std::mutex> lock(okMutex);
+            std::cerr << "[ExternalSorter] " << message << std::endl;
+            ok = false;
+        };
+        int outFd = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(outFd < 0){
+            std::cerr << "[ExternalSorter] Cannot open " << outputPath << std::endl;
+            return 0;
+        }
+        std::vector<std::string> partPaths(partitions);
+        std::vector<std::thread> mergers;
+        for(size_t p = 0; p < partitions; p++){
+            mergers.emplace_back([&, p](){
+                if(format == OutputFormat::Binary){
+                    // Every partition knows its place in the output, so all of them write straight into it.
+                    off_t offset = off_t(firstRecord[p] * sizeof(Record));
+                    mergeSlices(runs, cuts[p], cuts[p + 1], [&](const std::vector<Record>& records){
+                        size_t bytes = records.size() * sizeof(Record);
+                        if(bytes && pwrite(outFd, records.data(), bytes, offset) != ssize_t(bytes)){
+                            fail("Writing " + outputPath + " failed");
+                        }
+                        offset += off_t(bytes);
+                    });
+                    return;
+                }
+                // CSV rows have no fixed size, every partition formats into its own part file.
+                partPaths[p] = runPathPrefix + "." + std::to_string(p) + ".part";
+                std::ofstream part(partPaths[p]);
+                mergeSlices(runs, cuts[p], cuts[p + 1], [&](const std::vector<Record>& records){
+                    for(const Record& record : records){
+                        record.writeCSV(part);
+                    }
+                });
+                if(!part){
+                    fail("Writing " + partPaths[p] + " failed");
+                }
+            });
+        }
+        for(auto& merger : mergers){
+            merger.join();
+        }
+
+        if(format == OutputFormat::CSV){
+            std::string header = Record::csvHeader();
+            ok = ok && write(outFd, header.data(), header.size()) == ssize_t(header.size());
+            for(auto& path : partPaths){
+                ok = ok && appendFile(outFd, path);
+                std::filesystem::remove(path);
+            }
+        }
+        close(outFd);
+
+        files.clear();
+        for(auto& path : runPaths){
+            std::filesystem::remove(path);
+        }
+        runPaths.clear();
+        std::vector<Record>().swap(buffer);
+        if(!ok){
+            std::cerr << "[ExternalSorter] Writing " << outputPath << " failed" << std::endl;
+            return 0;
+        }
+        return total;
+    }
+};
+
+
+// One raw trade or open order of a multi-day export. day is YYYYMMDD, 0 when unknown.
+struct RawExportRecord{
+    char name[8];
+    uint32_t day;
+    uint32_t reserved;
+    uint64_t timestamp;
+    uint64_t volume;
+    double price;
+
+    static const char* csvHeader(){
+        return "day,name,ts,vol,price,\n";
+    }
+
+    void writeCSV(std::ostream& out) const {
+        out << day << "," << symbolString(name) << "," << timestamp << "," << volume << "," << price << ",\n";
+    }
+};
+
+// Symbol, then time.
+struct RawExportOrder{
+    bool operator()(const RawExportRecord& a, const RawExportRecord& b) const {
+        int byName = std::memcmp(a.name, b.name, sizeof(a.name));
+        if(byName != 0){
+            return byName < 0;
+        }
+        if(a.day != b.day){
+            return a.day < b.day;
+        }
+        return a.timestamp < b.timestamp;
+    }
+};
+
+using RawExportSorter = ExternalSorter<RawExportRecord, RawExportOrder>;
+
+// The day of an ITCH file named like 01302019.NASDAQ_ITCH50 (MMDDYYYY), as YYYYMMDD; 0 otherwise.
+inline uint32_t exportDay(const std::string& filePath){
+    std::string stem = std::filesystem::path(filePath).filename().string();
+    if(stem.size() < 8 || !std::all_of(stem.begin(), stem.begin() + 8, [](char c){ return c >= '0' && c <= '9'; })){
+        return 0;
+    }
+    uint32_t month = uint32_t(std::stoul(stem.substr(0, 2)));
+    uint32_t day = uint32_t(std::stoul(stem.substr(2, 2)));
+    uint32_t year = uint32_t(std::stoul(stem.substr(4, 4)));
+    return year * 10000 + month * 100 + day;
+}
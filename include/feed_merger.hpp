@@ -0,0 +1,131 @@
+#ifndef FEED_MERGER_HPP
+#define FEED_MERGER_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <queue>
+#include <memory>
+#include <unordered_map>
+#include "decoder.hpp"
+
+
+// Consolidates several venues' ITCH 5.0 feeds (e.g. Nasdaq, BX and PSX) into one timestamp ordered
+// stream of Events. Every feed is decoded by its own DecodePipeline thread, and a heap based k-way
+// merge on the calling thread picks the earliest pending Event. Decoding runs in parallel, so a
+// merged run costs about as much as the slowest feed.
+//
+// Events are rewritten so a single Parser can apply them:
+//  - stock locates are venue specific and are mapped to a common id per symbol, assigned from the
+//    feeds' Stock Directory messages in order of first appearance;
+//  - order reference and match numbers are only unique within a venue, so the feed index is put in
+//    their top 8 bits (feed 0 keeps its numbers unchanged);
+//  - a System Event is forwarded only once every feed has sent it, so the first feed to reach end of
+//    messages does not end the consolidated day.
+class FeedMerger{
+    static constexpr int feedShift = 56;
+
+    struct Feed{
+        std::unique_ptr<DecodePipeline> pipeline;
+        const Event* pending = nullptr;
+        std::vector<uint16_t> commonLocates;
+    };
+
+    // Earliest timestamp first, ties go to the lower feed index.
+    using HeapEntry = std::pair<uint64_t, size_t>;
+
+    std::vector<Feed> feeds;
+    std::unordered_map<std::string, uint16_t> symbolIds;
+    std::unordered_map<char, size_t> systemEventCounts;
+    uint16_t nextSymbolId = 1;
+
+    // Rewrites msg into the common id space, false when it is held back.
+    bool remap(size_t feedIndex, Event& msg){
+        Feed& feed = feeds[feedIndex];
+        if(msg.type == 'S'){
+            return ++systemEventCounts[msg.indicator] == feeds.size();
+        }
+        if(msg.type == 'R'){
+            std::string symbol = rstrip(std::string(msg.stock, sizeof(msg.stock)));
+            auto [it, inserted] = symbolIds.try_emplace(symbol, nextSymbolId);
+            if(inserted){
+                nextSymbolId++;
+            }
+            feed.commonLocates[msg.stockLocate] = it->second;
+        }
+        uint16_t commonLocate = feed.commonLocates[msg.stockLocate];
+        if(commonLocate == 0 && msg.stockLocate != 0){
+            std::cerr << "[FeedMerger] Feed " << feedIndex << " locate " << msg.stockLocate << " has no Stock Directory entry" << std::endl;
+            return false;
+        }
+        msg.stockLocate = commonLocate;
+
+        uint64_t tag = uint64_t(feedIndex) << feedShift;
+        if(msg.orderRefNumber){
+            msg.orderRefNumber |= tag;
+        }
+        if(msg.type == 'U'){
+            msg.newOrderRefNumber |= tag;
+        }
+        if(msg.matchNumber){
+            msg.matchNumber |= tag;
+        }
+        return true;
+    }
+
+    public:
+    // The feed index must fit the top bits of the order reference and match numbers.
+    static constexpr size_t maxFeeds = size_t(1) << (64 - feedShift);
+
+    // Starts no pipeline when there are more than maxFeeds feeds, see good().
+    FeedMerger(const std::vector<std::string>& feedPaths){
+        if(feedPaths.size() > maxFeeds){
+            std::cerr << "[FeedMerger] At most " << maxFeeds << " feeds can be merged, got " << feedPaths.size() << std::endl;
+            return;
+        }
+        for(auto& feedPath : feedPaths){
+            Feed feed;
+            feed.pipeline = std::make_unique<DecodePipeline>(feedPath);
+            feed.commonLocates.assign(size_t(UINT16_MAX) + 1, 0);
+            feeds.push_back(std::move(feed));
+        }
+    }
+
+    // False when the feeds were rejected and run() has nothing to merge.
+    bool good() const {
+        return !feeds.empty();
+    }
+
+    // Calls apply on every Event of every feed in timestamp order, on the calling thread.
+    template<typename F>
+    void run(F apply){
+        std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap;
+        for(size_t i = 0; i < feeds.size(); i++){
+            if((feeds[i].pending = feeds[i].pipeline->next())){
+                heap.push({feeds[i].pending->timestamp, i});
+            }
+        }
+
+        Event msg;
+        while(!heap.empty()){
+            size_t feedIndex = heap.top().second;
+            heap.pop();
+            Feed& feed = feeds[feedIndex];
+            msg = *feed.pending;
+            if(remap(feedIndex, msg)){
+                apply(msg);
+            }
+            if((feed.pending = feed.pipeline->next())){
+                heap.push({feed.pending->timestamp, feedIndex});
+            }
+        }
+    }
+
+    size_t symbolCount() const {
+        return symbolIds.size();
+    }
+};
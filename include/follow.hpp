@@ -0,0 +1,86 @@
+#ifndef FOLLOW_HPP
+#define FOLLOW_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+
+// Waits for a file that another process keeps appending to. Uses inotify when available,
+// otherwise polls the file size.
+class FileWatcher{
+    static constexpr int pollIntervalMillis = 5;
+
+    std::string filePath;
+    int inotifyFd = -1;
+    off_t lastSize = 0;
+
+    off_t currentSize() const {
+        struct stat info;
+        return stat(filePath.c_str(), &info) == 0 ? info.st_size : lastSize;
+    }
+
+    public:
+    FileWatcher(std::string filePath) : filePath(filePath) {
+        lastSize = currentSize();
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(inotifyFd >= 0 && inotify_add_watch(inotifyFd, filePath.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0){
+            close(inotifyFd);
+            inotifyFd = -1;
+        }
+        if(inotifyFd < 0){
+            std::cerr << "[FileWatcher] inotify unavailable for " << filePath << ", polling every " << pollIntervalMillis << " ms" << std::endl;
+        }
+    }
+
+    ~FileWatcher(){
+        if(inotifyFd >= 0){
+            close(inotifyFd);
+        }
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Current size of the file.
+    off_t size() const {
+        return currentSize();
+    }
+
+    // Blocks for at most timeoutMillis, true once the file has grown since the last call.
+    bool waitForGrowth(int timeoutMillis){
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+        while(true){
+            off_t size = currentSize();
+            if(size > lastSize){
+                lastSize = size;
+                return true;
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if(remaining <= 0){
+                return false;
+            }
+            if(inotifyFd >= 0){
+                pollfd watch{inotifyFd, POLLIN, 0};
+                if(poll(&watch, 1, int(remaining)) > 0){
+                    // Drain the queued events, the size check above decides.
+                    char events[4096];
+                    while(read(inotifyFd, events, sizeof(events)) > 0){
+                    }
+                }
+            }
+            else{
+                std::this_thread::sleep_for(std::chrono::milliseconds(std::min<long long>(remaining, pollIntervalMillis)));
+            }
+        }
+    }
+};
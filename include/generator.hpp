@@ -0,0 +1,500 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <queue>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include "message.hpp"
+
+
+// About the number of messages of a real Nasdaq day file, --scale multiplies it.
+constexpr uint64_t referenceDayMessages = 300000000;
+
+struct GeneratorConfig{
+    uint64_t seed = 1;
+    uint32_t symbols = 8000;
+    // Approximate, the generated file lands within a few percent.
+    uint64_t messages = 10000000;
+    // Symbol activity follows a Zipf law of this exponent over a random ranking of the symbols.
+    double zipfExponent = 1.1;
+    // Orders live an exponentially distributed time of this mean before their fate applies.
+    double meanOrderLifetimeMillis = 5000.0;
+    // Fate of an added order, normalized: executed (sometimes in two parts), partially cancelled
+    // and later deleted, deleted, or replaced by a new order that draws a fate of its own.
+    double executeRatio = 0.06;
+    double cancelRatio = 0.10;
+    double deleteRatio = 0.64;
+    double replaceRatio = 0.20;
+    // Share of executions sent as 'C' with a price, of adds sent as 'F' with an MPID,
+    // non displayed 'P' trades per add, and trades broken by a later 'B'.
+    double executeWithPriceRatio = 0.05;
+    double attributedRatio = 0.10;
+    double hiddenTradeRatio = 0.02;
+    double brokenTradeRatio = 0.0002;
+    // Message rate at 9:30 and 16:00 relative to midday, decaying over about 20 minutes.
+    double openBurst = 6.0;
+    double closeBurst = 4.0;
+    // Opening and closing cross 'Q' for every symbol.
+    bool crosses = true;
+};
+
+
+// Writes a valid, length prefixed ITCH 5.0 day file from the message layouts of message.hpp.
+// The day runs from the start of system hours at 4:00 to 20:00 with the open and close bursts of a
+// real session. Every draw comes from one std::mt19937_64 through the generator's own distributions
+// (the std:: distributions are implementation defined), so a seed always reproduces the same file.
+class ItchGenerator{
+    static constexpr uint64_t nanosPerMinute = 60ULL * 1000000000ULL;
+    static constexpr uint64_t nanosPerHour = 60 * nanosPerMinute;
+    static constexpr uint64_t systemStart = 4 * nanosPerHour;
+    static constexpr uint64_t marketOpen = 9 * nanosPerHour + 30 * nanosPerMinute;
+    static constexpr uint64_t marketClose = 16 * nanosPerHour;
+    static constexpr uint64_t systemEnd = 20 * nanosPerHour;
+    static constexpr uint32_t tick = 100;
+
+    struct Symbol{
+        char stock[8];
+        uint32_t mid;
+        double weight;
+    };
+
+    struct LiveOrder{
+        uint16_t stockLocate;
+        char side;
+        char fate;
+        uint8_t step;
+        uint32_t shares;
+        uint32_t price;
+    };
+
+    // A scheduled order fate step ('O', id is the order reference) or broken trade ('B', id is the match number).
+    struct Pending{
+        uint64_t time;
+        uint64_t sequence;
+        uint64_t id;
+        uint16_t stockLocate;
+        char kind;
+
+        bool operator>(const Pending& other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    GeneratorConfig config;
+    std::mt19937_64 rng;
+    std::vector<char> streamBuffer;
+    std::ofstream out;
+
+    std::vector<Symbol> symbols;
+    std::vector<double> activityCdf;
+    std::vector<double> minuteRates;
+    std::unordered_map<uint64_t, LiveOrder> live;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+
+    uint64_t now = 0;
+    uint64_t nextArrival = 0;
+    uint64_t nextOrderRef = 1;
+    uint64_t nextMatch = 1;
+    uint64_t sequence = 0;
+    uint64_t messagesWritten = 0;
+
+    double uniform(){
+        return double(rng() >> 11) * 0x1.0p-53;
+    }
+
+    double exponential(double mean){
+        return -std::log1p(-uniform()) * mean;
+    }
+
+    // 1 + a geometric count with success probability p, capped.
+    uint32_t geometric(double p, uint32_t cap){
+        uint32_t k = 1;
+        while(k < cap && uniform() > p){
+            k++;
+        }
+        return k;
+    }
+
+    uint16_t pickSymbol(){
+        size_t i = std::upper_bound(activityCdf.begin(), activityCdf.end(), uniform() * activityCdf.back()) - activityCdf.begin();
+        return uint16_t(std::min(i, symbols.size() - 1) + 1);
+    }
+
+    template<typename Message>
+    void emit(Message& msg){
+        msg.timestamp = now;
+        writeBinary(out, msg);
+        messagesWritten++;
+    }
+
+    void systemEvent(char eventCode){
+        SystemEvent msg{};
+        msg.eventCode = eventCode;
+        emit(msg);
+    }
+
+    // Bijective base 26 names: A..Z, AA..ZZ, AAA...
+    static void symbolName(size_t index, char (&stock)[8]){
+        std::string name;
+        for(size_t n = index + 1; n > 0; n = (n - 1) / 26){
+            name.insert(name.begin(), char('A' + (n - 1) % 26));
+        }
+        std::memset(stock, ' ', sizeof(stock));
+        std::memcpy(stock, name.data(), std::min(name.size(), sizeof(stock)));
+    }
+
+    void setupSymbols(){
+        symbols.resize(config.symbols);
+        std::vector<size_t> rank(symbols.size());
+        for(size_t i = 0; i < rank.size(); i++){
+            rank[i] = i + 1;
+        }
+        for(size_t i = rank.size(); i > 1; i--){
+            std::swap(rank[i - 1], rank[rng() % i]);
+        }
+        double total = 0.0;
+        for(size_t i = 0; i < symbols.size(); i++){
+            symbolName(i, symbols[i].stock);
+            symbols[i].mid = uint32_t(5 + uniform() * 495) * 10000;
+            symbols[i].weight = 1.0 / std::pow(double(rank[i]), config.zipfExponent);
+            total += symbols[i].weight;
+            activityCdf.push_back(total);
+        }
+    }
+
+    // Expected messages per added order, from the fate ratios.
+    double messagesPerAdd(double execute, double cancel, double remove, double replace) const {
+        double chain = (execute * 1.25 + cancel * 2.0 + remove + replace) / std::max(1.0 - replace, 1e-9);
+        return 1.0 + chain + config.hiddenTradeRatio;
+    }
+
+    // Add order arrival rate per nanosecond for every minute of the day, shaped by the open and close bursts.
+    void setupRates(double adds){
+        size_t minutes = (systemEnd - systemStart) / nanosPerMinute;
+        std::vector<double> weights(minutes);
+        double total = 0.0;
+        for(size_t m = 0; m < minutes; m++){
+            double t = double(systemStart + m * nanosPerMinute);
+            if(t < marketOpen){
+                weights[m] = 0.05;
+            }
+            else if(t >= marketClose){
+                weights[m] = 0.04;
+            }
+            else{
+                weights[m] = 1.0 + config.openBurst * std::exp(-(t - marketOpen) / (20.0 * nanosPerMinute))
+                                 + config.closeBurst * std::exp(-(marketClose - t) / (20.0 * nanosPerMinute));
+            }
+            total += weights[m];
+        }
+        minuteRates.resize(minutes);
+        for(size_t m = 0; m < minutes; m++){
+            minuteRates[m] = adds * weights[m] / total / double(nanosPerMinute);
+        }
+    }
+
+    // Next arrival of the non homogeneous Poisson process after t, UINT64_MAX past the end of the day.
+    uint64_t arrivalAfter(uint64_t t){
+        double work = exponential(1.0);
+        double time = double(t);
+        for(size_t m = (t - systemStart) / nanosPerMinute; m < minuteRates.size(); m++){
+            double end = double(systemStart + (m + 1) * nanosPerMinute);
+            double capacity = minuteRates[m] * (end - time);
+            if(minuteRates[m] > 0 && work <= capacity){
+                return std::max(t + 1, uint64_t(time + work / minuteRates[m]));
+            }
+            work -= capacity;
+            time = end;
+        }
+        return UINT64_MAX;
+    }
+
+    void schedule(uint64_t time, char kind, uint64_t id, uint16_t stockLocate){
+        if(time < systemEnd){
+            pending.push({time, sequence++, id, stockLocate, kind});
+        }
+    }
+
+    char drawFate(){
+        double total = config.executeRatio + config.cancelRatio + config.deleteRatio + config.replaceRatio;
+        double u = uniform() * total;
+        if((u -= config.executeRatio) < 0){
+            return 'E';
+        }
+        if((u -= config.cancelRatio) < 0){
+            return 'X';
+        }
+        if((u -= config.deleteRatio) < 0){
+            return 'D';
+        }
+        return 'U';
+    }
+
+    uint32_t quotePrice(Symbol& symbol, char side){
+        uint32_t offset = (geometric(0.35, 20) - 1) * tick;
+        return side == 'B' ? std::max(symbol.mid - std::min(offset, symbol.mid - tick), tick) : symbol.mid + offset;
+    }
+
+    void lifetime(uint64_t orderRefNumber, LiveOrder& order){
+        order.fate = drawFate();
+        order.step = 0;
+        schedule(now + uint64_t(exponential(config.meanOrderLifetimeMillis * 1e6)), 'O', orderRefNumber, order.stockLocate);
+    }
+
+    void maybeBreak(uint64_t matchNumber, uint16_t stockLocate){
+        if(uniform() < config.brokenTradeRatio){
+            schedule(now + uint64_t((1.0 + 59.0 * uniform()) * 1e9), 'B', matchNumber, stockLocate);
+        }
+    }
+
+    void addOrder(){
+        uint16_t stockLocate = pickSymbol();
+        Symbol& symbol = symbols[stockLocate - 1];
+        if(uniform() < 0.1){
+            symbol.mid = uniform() < 0.5 ? symbol.mid + tick : std::max(symbol.mid - tick, tick);
+        }
+        LiveOrder order{stockLocate, uniform() < 0.5 ? 'B' : 'S', 0, 0, 100 * geometric(0.4, 50), 0};
+        order.price = quotePrice(symbol, order.side);
+        uint64_t orderRefNumber = nextOrderRef++;
+
+        AddOrderWithMPID msg{};
+        msg.stockLocate = stockLocate;
+        msg.orderRefNumber = orderRefNumber;
+        msg.buySellIndicator = order.side;
+        msg.shares = order.shares;
+        std::memcpy(msg.stock, symbol.stock, sizeof(msg.stock));
+        msg.priceRaw = order.price;
+        if(uniform() < config.attributedRatio){
+            std::memcpy(msg.attribution, "GSCO", sizeof(msg.attribution));
+            emit(msg);
+        }
+        else{
+            emit(static_cast<AddOrderNoMPID&>(msg));
+        }
+        lifetime(orderRefNumber, live.emplace(orderRefNumber, order).first->second);
+
+        if(uniform() < config.hiddenTradeRatio){
+            NonCrossTrade trade{};
+            trade.stockLocate = stockLocate;
+            trade.buySellIndicator = 'B';
+            trade.shares = 100 * geometric(0.5, 20);
+            std::memcpy(trade.stock, symbol.stock, sizeof(trade.stock));
+            trade.priceRaw = symbol.mid;
+            trade.matchNumber = nextMatch++;
+            emit(trade);
+            maybeBreak(trade.matchNumber, stockLocate);
+        }
+    }
+
+    void execute(uint64_t orderRefNumber, LiveOrder& order, uint32_t shares){
+        OrderExecutedWithPrice msg{};
+        msg.stockLocate = order.stockLocate;
+        msg.orderRefNumber = orderRefNumber;
+        msg.executedShares = shares;
+        msg.matchNumber = nextMatch++;
+        if(uniform() < config.executeWithPriceRatio){
+            msg.printable = 'Y';
+            msg.executionPriceRaw = order.price;
+            emit(msg);
+        }
+        else{
+            emit(static_cast<OrderExecuted&>(msg));
+        }
+        order.shares -= shares;
+        maybeBreak(msg.matchNumber, order.stockLocate);
+    }
+
+    void deleteOrder(uint64_t orderRefNumber, LiveOrder& order){
+        OrderDelete msg{};
+        msg.stockLocate = order.stockLocate;
+        msg.orderRefNumber = orderRefNumber;
+        emit(msg);
+        live.erase(orderRefNumber);
+    }
+
+    void onFate(const Pending& event){
+        auto it = live.find(event.id);
+        if(it == live.end()){
+            return;
+        }
+        uint64_t orderRefNumber = it->first;
+        LiveOrder& order = it->second;
+        double meanNanos = config.meanOrderLifetimeMillis * 1e6;
+        switch(order.fate){
+            case 'E':
+                if(order.step == 0 && order.shares >= 200 && uniform() < 0.25){
+                    execute(orderRefNumber, order, order.shares / 200 * 100);
+                    order.step = 1;
+                    schedule(now + uint64_t(exponential(meanNanos / 4)), 'O', orderRefNumber, order.stockLocate);
+                    return;
+                }
+                execute(orderRefNumber, order, order.shares);
+                live.erase(it);
+                return;
+            case 'X':
+                if(order.step == 0 && order.shares >= 200){
+                    OrderCancel msg{};
+                    msg.stockLocate = order.stockLocate;
+                    msg.orderRefNumber = orderRefNumber;
+                    msg.cancelledShares = order.shares / 200 * 100;
+                    emit(msg);
+                    order.shares -= msg.cancelledShares;
+                    order.step = 1;
+                    schedule(now + uint64_t(exponential(meanNanos / 2)), 'O', orderRefNumber, order.stockLocate);
+                    return;
+                }
+                deleteOrder(orderRefNumber, order);
+                return;
+            case 'D':
+                deleteOrder(orderRefNumber, order);
+                return;
+            default: {
+                LiveOrder replacement = order;
+                replacement.shares = 100 * geometric(0.4, 50);
+                replacement.price = quotePrice(symbols[order.stockLocate - 1], order.side);
+                OrderReplace msg{};
+                msg.stockLocate = order.stockLocate;
+                msg.originalOrderRefNumber = orderRefNumber;
+                msg.newOrderRefNumber = nextOrderRef++;
+                msg.shares = replacement.shares;
+                msg.priceRaw = replacement.price;
+                emit(msg);
+                live.erase(it);
+                lifetime(msg.newOrderRefNumber, live.emplace(msg.newOrderRefNumber, replacement).first->second);
+                return;
+            }
+        }
+    }
+
+    // Applies adds and scheduled events in time order up to (excluding) limit.
+    void runUntil(uint64_t limit){
+        while(true){
+            uint64_t next = std::min(nextArrival, pending.empty() ? UINT64_MAX : pending.top().time);
+            if(next >= limit){
+                break;
+            }
+            now = next;
+            if(nextArrival == next){
+                addOrder();
+                nextArrival = arrivalAfter(now);
+                continue;
+            }
+            Pending event = pending.top();
+            pending.pop();
+            if(event.kind == 'O'){
+                onFate(event);
+            }
+            else{
+                BrokenTrade msg{};
+                msg.stockLocate = event.stockLocate;
+                msg.matchNumber = event.id;
+                emit(msg);
+            }
+        }
+        now = limit;
+    }
+
+    void crossAll(char crossType){
+        double maxWeight = 0.0;
+        for(auto& symbol : symbols){
+            maxWeight = std::max(maxWeight, symbol.weight);
+        }
+        for(size_t i = 0; i < symbols.size(); i++){
+            CrossTrade msg{};
+            msg.stockLocate = uint16_t(i + 1);
+            msg.shares = 100 * (1 + uint64_t(symbols[i].weight / maxWeight * 50000 * uniform()));
+            std::memcpy(msg.stock, symbols[i].stock, sizeof(msg.stock));
+            msg.crossPriceRaw = symbols[i].mid;
+            msg.matchNumber = nextMatch++;
+            msg.crossType = crossType;
+            emit(msg);
+        }
+    }
+
+    public:
+    ItchGenerator(const GeneratorConfig& generatorConfig) : config(generatorConfig), rng(generatorConfig.seed), streamBuffer(1 << 22) {
+        if(config.symbols == 0 || config.symbols > UINT16_MAX){
+            std::cerr << "[ItchGenerator] Symbol count must be between 1 and " << UINT16_MAX << std::endl;
+            config.symbols = std::clamp<uint32_t>(config.symbols, 1, UINT16_MAX);
+        }
+    }
+
+    // Returns the number of messages written.
+    uint64_t write(const std::string& filePath){
+        out.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+        out.open(filePath, std::ios::binary);
+        if(!out){
+            std::cerr << "[ItchGenerator] Cannot open " << filePath << std::endl;
+            return 0;
+        }
+        setupSymbols();
+        uint64_t fixedMessages = 6 + 2 * uint64_t(symbols.size()) * (config.crosses ? 2 : 1);
+        double perAdd = messagesPerAdd(config.executeRatio, config.cancelRatio, config.deleteRatio, config.replaceRatio);
+        double totalFates = config.executeRatio + config.cancelRatio + config.deleteRatio + config.replaceRatio;
+        if(totalFates > 0){
+            perAdd = messagesPerAdd(config.executeRatio / totalFates, config.cancelRatio / totalFates,
+                                    config.deleteRatio / totalFates, config.replaceRatio / totalFates);
+        }
+        setupRates(config.messages > fixedMessages ? double(config.messages - fixedMessages) / perAdd : 0.0);
+
+        now = 3 * nanosPerHour;
+        systemEvent('O');
+        for(size_t i = 0; i < symbols.size(); i++){
+            StockDirectory directory{};
+            directory.stockLocate = uint16_t(i + 1);
+            std::memcpy(directory.stock, symbols[i].stock, sizeof(directory.stock));
+            directory.marketCategory = 'Q';
+            directory.finStatus = 'N';
+            directory.roundLotSize = 100;
+            directory.roundLotsOnly = 'N';
+            directory.issueClassification = 'C';
+            std::memcpy(directory.issueSubType, "Z ", 2);
+            directory.authenticity = 'P';
+            directory.shortSaleThreshIndicator = 'N';
+            directory.ipoFlag = 'N';
+            directory.LULDRefPriceTier = '1';
+            directory.etpFlag = 'N';
+            directory.invIndicator = 'N';
+            emit(directory);
+
+            StockTradingAction action{};
+            action.stockLocate = directory.stockLocate;
+            std::memcpy(action.stock, symbols[i].stock, sizeof(action.stock));
+            action.tradingState = 'T';
+            action.reserved = ' ';
+            std::memcpy(action.reason, "    ", 4);
+            emit(action);
+        }
+
+        now = systemStart;
+        systemEvent('S');
+        nextArrival = arrivalAfter(now);
+        runUntil(marketOpen);
+        systemEvent('Q');
+        if(config.crosses){
+            crossAll('O');
+        }
+        runUntil(marketClose);
+        if(config.crosses){
+            crossAll('C');
+        }
+        systemEvent('M');
+        runUntil(systemEnd);
+        systemEvent('E');
+        now = systemEnd + 5 * nanosPerMinute;
+        systemEvent('C');
+        out.close();
+        return messagesWritten;
+    }
+};
@@ -0,0 +1,289 @@
+#ifndef LIVE_VWAP_HPP
+#define LIVE_VWAP_HPP
+#endif
+
+#pragma once
+
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <string_view>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <string>
+#include <ostream>
+#include <poll.h>
+#include <unistd.h>
+#include "async_writer.hpp"
+
+
+// Running aggregates of one symbol since the start of the day.
+struct LiveSymbol{
+    char name[8];
+    uint16_t stockLocate;
+    uint64_t trades;
+    uint64_t volume;
+    double pv;
+    uint64_t lastTradeTimestamp;
+
+    double vwap() const {
+        return volume == 0 ? 0.0 : pv / double(volume);
+    }
+};
+
+// An immutable view of every symbol that has traded, in stock locate order.
+struct LiveSnapshot{
+    uint64_t sequence = 0;
+    // Feed time of the last trade included
+    uint64_t timestamp = 0;
+    std::vector<LiveSymbol> symbols;
+    // Readers holding this snapshot, see LiveVWAP::acquire()
+    std::atomic<uint32_t> readers{0};
+
+    const LiveSymbol* find(std::string_view name) const {
+        for(const LiveSymbol& symbol : symbols){
+            if(symbolString(symbol.name) == name){
+                return &symbol;
+            }
+        }
+        return nullptr;
+    }
+
+    const LiveSymbol* find(uint16_t stockLocate) const {
+        auto it = std::lower_bound(symbols.begin(), symbols.end(), stockLocate, [](const LiveSymbol& symbol, uint16_t locate){
+            return symbol.stockLocate < locate;
+        });
+        return it != symbols.end() && it->stockLocate == stockLocate ? &*it : nullptr;
+    }
+};
+
+
+// Running VWAP and volume of a parse in progress, for any number of reader threads.
+//
+// The parse thread updates plain per-locate totals and, every publishIntervalMillis of wall time,
+// copies the symbols that have traded into a snapshot and publishes it with one atomic pointer store
+// (RCU style). Readers pin the current snapshot by counting themselves into it and never block the
+// parse thread or each other. Snapshots are recycled rather than freed: the parse thread rebuilds
+// one that is neither current nor pinned, and only allocates another when all of them are pinned.
+// Publishing therefore costs one copy of the traded symbols' totals, whatever the number of readers.
+class LiveVWAP{
+    // Checking the clock on every trade would cost more than the trade itself.
+    static constexpr uint32_t tradesPerClockCheck = 1024;
+
+    std::chrono::steady_clock::duration publishInterval;
+    std::chrono::steady_clock::time_point nextPublish;
+    uint32_t tradesSinceCheck = 0;
+    bool changed = false;
+    bool held = false;
+
+    // Parse thread only
+    std::vector<LiveSymbol> totals;
+    // Set once a locate is in tradedLocates; trades can drop back to 0 after broken trades.
+    std::vector<bool> listed;
+    std::vector<uint16_t> tradedLocates;
+    uint64_t lastTimestamp = 0;
+    uint64_t sequence = 0;
+
+    std::vector<std::unique_ptr<LiveSnapshot>> snapshots;
+    std::atomic<LiveSnapshot*> current{nullptr};
+
+    LiveSnapshot& freeSnapshot(){
+        LiveSnapshot* published = current.load(std::memory_order_relaxed);
+        for(auto& snapshot : snapshots){
+            if(snapshot.get() != published && snapshot->readers.load() == 0){
+                return *snapshot;
+            }
+        }
+        snapshots.push_back(std::make_unique<LiveSnapshot>());
+        return *snapshots.back();
+    }
+
+    void maybePublish(){
+        if(held || ++tradesSinceCheck < tradesPerClockCheck){
+            return;
+        }
+        tradesSinceCheck = 0;
+        if(std::chrono::steady_clock::now() >= nextPublish){
+            publish();
+        }
+    }
+
+    public:
+    // A pinned snapshot, valid until the handle is destroyed.
+    class Handle{
+        LiveSnapshot* snapshot = nullptr;
+
+        public:
+        Handle() = default;
+        explicit Handle(LiveSnapshot* snapshot) : snapshot(snapshot) {}
+        Handle(Handle&& other) noexcept : snapshot(std::exchange(other.snapshot, nullptr)) {}
+        Handle& operator=(Handle&& other) noexcept {
+            std::swap(snapshot, other.snapshot);
+            return *this;
+        }
+        ~Handle(){
+            if(snapshot){
+                snapshot->readers.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        explicit operator bool() const {
+            return snapshot != nullptr;
+        }
+
+        const LiveSnapshot* operator->() const {
+            return snapshot;
+        }
+
+        const LiveSnapshot& operator*() const {
+            return *snapshot;
+        }
+    };
+
+    LiveVWAP(uint64_t publishIntervalMillis = 100)
+        : publishInterval(std::chrono::milliseconds(publishIntervalMillis)), nextPublish(std::chrono::steady_clock::now() + publishInterval),
+          totals(size_t(UINT16_MAX) + 1, LiveSymbol{}), listed(size_t(UINT16_MAX) + 1, false) {
+        for(size_t stockLocate = 0; stockLocate < totals.size(); stockLocate++){
+            std::memset(totals[stockLocate].name, ' ', sizeof(totals[stockLocate].name));
+            totals[stockLocate].stockLocate = uint16_t(stockLocate);
+        }
+        snapshots.push_back(std::make_unique<LiveSnapshot>());
+        snapshots.push_back(std::make_unique<LiveSnapshot>());
+    }
+
+    LiveVWAP(const LiveVWAP&) = delete;
+    LiveVWAP& operator=(const LiveVWAP&) = delete;
+
+    // Parse thread side, driven by the Parser.
+
+    void onSymbol(uint16_t stockLocate, const char (&stock)[8]){
+        std::memcpy(totals[stockLocate].name, stock, sizeof(stock));
+    }
+
+    void onTrade(uint16_t stockLocate, uint64_t ts, double tradePV, uint64_t volume){
+        LiveSymbol& symbol = totals[stockLocate];
+        if(!listed[stockLocate]){
+            listed[stockLocate] = true;
+            tradedLocates.insert(std::upper_bound(tradedLocates.begin(), tradedLocates.end(), stockLocate), stockLocate);
+        }
+        symbol.trades++;
+        symbol.volume += volume;
+        symbol.pv += tradePV;
+        symbol.lastTradeTimestamp = ts;
+        lastTimestamp = std::max(lastTimestamp, ts);
+        changed = true;
+        maybePublish();
+    }
+
+    void onBrokenTrade(uint16_t stockLocate, double tradePV, uint64_t volume){
+        LiveSymbol& symbol = totals[stockLocate];
+        symbol.trades -= std::min<uint64_t>(symbol.trades, 1);
+        symbol.volume -= std::min(volume, symbol.volume);
+        symbol.pv -= tradePV;
+        changed = true;
+        maybePublish();
+    }
+
+    // Suspends the periodic publication while the parse is catching up; releasing publishes at once.
+    void holdPublishing(bool hold){
+        held = hold;
+        if(!held){
+            publish();
+        }
+    }
+
+    // Publishes the totals now. Called at the end of the parse, so the last snapshot is complete.
+    void publish(){
+        nextPublish = std::chrono::steady_clock::now() + publishInterval;
+        if(!changed && current.load(std::memory_order_relaxed)){
+            return;
+        }
+        LiveSnapshot& snapshot = freeSnapshot();
+        snapshot.sequence = ++sequence;
+        snapshot.timestamp = lastTimestamp;
+        snapshot.symbols.clear();
+        for(uint16_t stockLocate : tradedLocates){
+            snapshot.symbols.push_back(totals[stockLocate]);
+        }
+        current.store(&snapshot);
+        changed = false;
+    }
+
+    // Reader side, any thread.
+
+    // The latest published snapshot, empty before the first one. Lock free: a reader only retries
+    // when a publication overtakes it between loading and pinning the snapshot.
+    Handle acquire() const {
+        while(true){
+            LiveSnapshot* snapshot = current.load();
+            if(!snapshot){
+                return Handle();
+            }
+            snapshot->readers.fetch_add(1);
+            // Pinned only if still current: otherwise the parse thread may already be rebuilding it.
+            if(current.load() == snapshot){
+                return Handle(snapshot);
+            }
+            snapshot->readers.fetch_sub(1);
+        }
+    }
+};
+
+
+inline void printLiveSymbol(const LiveSnapshot& snapshot, const LiveSymbol& symbol, std::ostream& out){
+    out << snapshot.sequence << "," << symbolString(symbol.name) << "," << symbol.lastTradeTimestamp << ","
+        << symbol.vwap() << "," << symbol.volume << "," << symbol.trades << ",\n";
+}
+
+// Answers "SYM[,SYM...]" lines, or "*" for every symbol, read from fd with the latest snapshot.
+// Returns at the end of fd, or once running is cleared and no query is pending.
+inline void answerLiveQueries(const LiveVWAP& live, const std::atomic<bool>& running, int fd, std::ostream& out){
+    std::string pending;
+    char buffer[4096];
+    while(true){
+        pollfd watch{fd, POLLIN, 0};
+        int ready = poll(&watch, 1, 100);
+        if(ready == 0){
+            if(!running){
+                return;
+            }
+            continue;
+        }
+        ssize_t bytes = ready > 0 ? read(fd, buffer, sizeof(buffer)) : -1;
+        if(bytes <= 0){
+            return;
+        }
+        pending.append(buffer, size_t(bytes));
+        for(size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n')){
+            std::string line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+            if(line.empty()){
+                continue;
+            }
+            LiveVWAP::Handle snapshot = live.acquire();
+            if(!snapshot){
+                std::cerr << "[LiveVWAP] No snapshot published yet" << std::endl;
+                continue;
+            }
+            if(line == "*"){
+                for(const LiveSymbol& symbol : snapshot->symbols){
+                    printLiveSymbol(*snapshot, symbol, out);
+                }
+            }
+            else{
+                for(const std::string& name : splitString(line, ',')){
+                    if(const LiveSymbol* symbol = snapshot->find(name)){
+                        printLiveSymbol(*snapshot, *symbol, out);
+                    }
+                    else{
+                        std::cerr << "[LiveVWAP] Symbol " << name << " has not traded yet" << std::endl;
+                    }
+                }
+            }
+            out.flush();
+        }
+    }
+}
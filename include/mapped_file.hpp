@@ -0,0 +1,66 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+// Read-only mapping of a whole file.
+class MappedFile{
+    const char* mapping = nullptr;
+    size_t length = 0;
+
+    public:
+    MappedFile(const std::string& filePath){
+        int fd = open(filePath.c_str(), O_RDONLY);
+        struct stat info;
+        if(fd < 0 || fstat(fd, &info) != 0){
+            std::cerr << "Error opening " << filePath << std::endl;
+            if(fd >= 0){
+                close(fd);
+            }
+            return;
+        }
+        length = size_t(info.st_size);
+        if(length){
+            void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            mapping = p == MAP_FAILED ? nullptr : static_cast<const char*>(p);
+            if(!mapping){
+                length = 0;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile(){
+        if(mapping){
+            munmap(const_cast<char*>(mapping), length);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Tells the kernel to read ahead aggressively, for single front to back passes.
+    void adviseSequential() const {
+        if(mapping){
+            madvise(const_cast<char*>(mapping), length, MADV_SEQUENTIAL);
+        }
+    }
+
+    const char* data() const {
+        return mapping;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
@@ -5,84 +5,48 @@
 #pragma once
 #include <map>
 #include <string>
-#include <fstream>
+#include <tuple>
 #include <iostream>
 #include "utils.hpp"
+#include "schema.hpp"
 
 
-const std::map<char, int> packet_sizes = {
-    {'S', 11},  // System Event Message
-    {'R', 38},  // Stock Directory Message
-    {'H', 24},  // Stock Trading Action
-    {'Y', 19},  // Reg SHO Short Sale Price Test RestrictedIndicator Message
-    {'L', 25},  // Market Participant Position Message
-    {'V', 34},  // MWCB Decline Level Message
-    {'W', 11},  // MWCB Status Message
-    {'K', 27},  // Quoting Period Update
-    {'J', 34},  // Limit Up – Limit Down (LULD) Auction Collar Message
-    {'h', 20},  // Operational Halt Message
-    {'A', 35},  // Order Message (Add)
-    {'F', 39},  // Order Message (Add with mpid)
-    {'E', 30},  // Order Message (Execution)
-    {'C', 35},  // Order Message (Execution with updated price)
-    {'X', 22},  // Order Message (Cancel)
-    {'D', 18},  // Order Message (Delete)
-    {'U', 34},  // Order Message (Replace)
-    {'P', 43},  // Trade Message (Non-Cross)
-    {'Q', 39},  // Trade Message (Cross)
-    {'B', 18},  // Trade Message (Broken)
-    {'I', 49},  // Net Order Imbalance Indicator (NOII) Message
-    {'O', 47},  // Direct Listing with Capital Raise Price Discovery Message
-    {'N', 19}   // Retail Price Improvement Indicator(RPII)
-};
-
-#pragma pack(push, 1)
-
-struct baseMessage{
-
-    public :
-    virtual void load(std::ifstream &file) = 0;
-    virtual void show() = 0;
-};
-
-struct SystemEvent : public baseMessage {
-    public:
+// Every struct keeps the raw wire values of its message (prices as raw integers, alpha fields as
+// space padded char arrays). Its Schema specialization is the only description of the layout:
+// load(), show(), decodeMessage(), encodeMessage() and the CSV / binary writers are all generated from it.
+
+struct SystemEvent : public MessageBase<SystemEvent> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     char eventCode;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        file.read(&eventCode, sizeof(eventCode));
-    }
-
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Event Code -> " << eventCode << std::endl;
-    }   
+template<>
+struct Schema<SystemEvent>{
+    static constexpr char type = 'S';
+    static constexpr size_t size = 12;
+    static constexpr const char* title = "System Event";
+    static constexpr auto fields = std::tuple_cat(headerFields<SystemEvent>(), std::make_tuple(
+        Field<&SystemEvent::eventCode, 11, 1>{"Event Code"}
+    ));
 };
 
 
 // At the start of each tradingday, Nasdaq disseminates stock directory messages for allactive symbolsin the Nasdaq execution system.
 // Market data redistributors should process this message to populate the FinancialStatusIndicator (required display
 // field) and the Market Category (recommended display field) for Nasdaq listed issues
-struct StockDirectory : public baseMessage {
-    public:
+struct StockDirectory : public MessageBase<StockDirectory> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    std::string stock;
+    char stock[8];
     char marketCategory;
     char finStatus;
     uint32_t roundLotSize;
     char roundLotsOnly;
     char issueClassification;
-    std::string issueSubType;
+    char issueSubType[2];
     char authenticity;
     char shortSaleThreshIndicator;
     char ipoFlag;
@@ -90,45 +54,29 @@ struct StockDirectory : public baseMessage {
     char etpFlag;
     uint32_t etpLeverageFactor;
     char invIndicator;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        stock = readStock(file);
-        file.read(&marketCategory, sizeof(marketCategory));
-        file.read(&finStatus, sizeof(finStatus));
-        roundLotSize = readBigEndianInteger(file, 4);
-        file.read(&roundLotsOnly, sizeof(roundLotsOnly));
-        file.read(&issueClassification, sizeof(issueClassification));
-        issueSubType = readString(file, 2);
-        file.read(&authenticity, sizeof(authenticity));
-        file.read(&shortSaleThreshIndicator, sizeof(shortSaleThreshIndicator));
-        file.read(&ipoFlag, sizeof(ipoFlag));
-        file.read(&LULDRefPriceTier, sizeof(LULDRefPriceTier));
-        file.read(&etpFlag, sizeof(etpFlag));
-        etpLeverageFactor = readBigEndianInteger(file, 4);
-        file.read(&invIndicator, sizeof(invIndicator));
-    }
-    void show()  {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Market Category -> " << marketCategory << std::endl;
-        std::cout << "Financial Status -> " << finStatus << std::endl;
-        std::cout << "Round Lot Size -> " << roundLotSize << std::endl;
-        std::cout << "Round Lots Only -> " << roundLotsOnly << std::endl;
-        std::cout << "Issue Classification -> " << issueClassification << std::endl;
-        std::cout << "Issue Sub Type -> " << issueSubType << std::endl;
-        std::cout << "Authenticity -> " << authenticity << std::endl;
-        std::cout << "Short Sale Threshold Indicator -> " << shortSaleThreshIndicator << std::endl;
-        std::cout << "IPO Flag -> " << ipoFlag << std::endl;
-        std::cout << "LULD Reference Price Tier -> " << LULDRefPriceTier << std::endl;
-        std::cout << "ETP Flag -> " << etpFlag << std::endl;
-        std::cout << "ETP Leverage Factor -> " << etpLeverageFactor << std::endl;
-        std::cout << "Investment Indicator -> " << invIndicator << std::endl;
-    }
+template<>
+struct Schema<StockDirectory>{
+    static constexpr char type = 'R';
+    static constexpr size_t size = 39;
+    static constexpr const char* title = "Stock Directory";
+    static constexpr auto fields = std::tuple_cat(headerFields<StockDirectory>(), std::make_tuple(
+        Field<&StockDirectory::stock, 11, 8>{"Stock"},
+        Field<&StockDirectory::marketCategory, 19, 1>{"Market Category"},
+        Field<&StockDirectory::finStatus, 20, 1>{"Financial Status"},
+        Field<&StockDirectory::roundLotSize, 21, 4>{"Round Lot Size"},
+        Field<&StockDirectory::roundLotsOnly, 25, 1>{"Round Lots Only"},
+        Field<&StockDirectory::issueClassification, 26, 1>{"Issue Classification"},
+        Field<&StockDirectory::issueSubType, 27, 2>{"Issue Sub Type"},
+        Field<&StockDirectory::authenticity, 29, 1>{"Authenticity"},
+        Field<&StockDirectory::shortSaleThreshIndicator, 30, 1>{"Short Sale Threshold Indicator"},
+        Field<&StockDirectory::ipoFlag, 31, 1>{"IPO Flag"},
+        Field<&StockDirectory::LULDRefPriceTier, 32, 1>{"LULD Reference Price Tier"},
+        Field<&StockDirectory::etpFlag, 33, 1>{"ETP Flag"},
+        Field<&StockDirectory::etpLeverageFactor, 34, 4>{"ETP Leverage Factor"},
+        Field<&StockDirectory::invIndicator, 38, 1>{"Investment Indicator"}
+    ));
 };
 
 
@@ -145,36 +93,27 @@ struct StockDirectory : public baseMessage {
 // • Paused (* The paused status will be disseminated for NASDAQ-listed securities only. Trading pauses on non-NASDAQ listed securities will be treated simply as a halt.)
 // • Released for quotation
 // • Released for trading
-struct StockTradingAction: public baseMessage{
-    public:
+struct StockTradingAction : public MessageBase<StockTradingAction> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    std::string stock;
+    char stock[8];
     char tradingState;
-    char reversed;
-    std::string reason;
-
-
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        stock = readStock(file);
-        file.read(&tradingState, sizeof(tradingState));
-        file.read(&reversed, sizeof(reversed));
-        reason = readString(file, 4);
-    }
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Trading State -> " << tradingState << std::endl;
-        std::cout << "Reversed -> " << reversed << std::endl;
-        std::cout << "Reason -> " << reason << std::endl;
-    }
+    char reserved;
+    char reason[4];
+};
 
+template<>
+struct Schema<StockTradingAction>{
+    static constexpr char type = 'H';
+    static constexpr size_t size = 25;
+    static constexpr const char* title = "Stock Trading Action";
+    static constexpr auto fields = std::tuple_cat(headerFields<StockTradingAction>(), std::make_tuple(
+        Field<&StockTradingAction::stock, 11, 8>{"Stock"},
+        Field<&StockTradingAction::tradingState, 19, 1>{"Trading State"},
+        Field<&StockTradingAction::reserved, 20, 1>{"Reserved"},
+        Field<&StockTradingAction::reason, 21, 4>{"Reason"}
+    ));
 };
 
 
@@ -188,31 +127,23 @@ struct StockTradingAction: public baseMessage{
 // For other exchange-•-listed issues, Nasdaq relays the Reg SHO Short Sale Price Test Restricted Indicator
 // message when it receives an update from the primary listing exchange.
 // Nasdaq processes orders based on the most Reg SHO Restriction status value
-struct RegSHOShortSalePriceTestIndicator : public baseMessage {
-    public:
-    uint16_t locateCode;
+struct RegSHOShortSalePriceTestIndicator : public MessageBase<RegSHOShortSalePriceTestIndicator> {
+    uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    std::string stock;
+    char stock[8];
     char regSHOAction;
+};
 
-    void load(std::ifstream &file){
-        locateCode = readBigEndianInteger(file, 2);
-        //file.read(reinterpret_cast<char*>(&locateCode), sizeof(locateCode));
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        stock = readStock(file);
-        file.read(&regSHOAction, sizeof(regSHOAction));
-    }
-
-    void show() {
-        std::cout << "Locate Code -> " << locateCode << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Reg SHO Action -> " << regSHOAction << std::endl;
-    }
-
+template<>
+struct Schema<RegSHOShortSalePriceTestIndicator>{
+    static constexpr char type = 'Y';
+    static constexpr size_t size = 20;
+    static constexpr const char* title = "Reg SHO Short Sale Price Test Restricted Indicator";
+    static constexpr auto fields = std::tuple_cat(headerFields<RegSHOShortSalePriceTestIndicator>(), std::make_tuple(
+        Field<&RegSHOShortSalePriceTestIndicator::stock, 11, 8>{"Stock"},
+        Field<&RegSHOShortSalePriceTestIndicator::regSHOAction, 19, 1>{"Reg SHO Action"}
+    ));
 };
 
 
@@ -222,175 +153,126 @@ struct RegSHOShortSalePriceTestIndicator : public baseMessage {
 // comply with certain market place rules.
 // Through out the day,Nasdaq will send out this message only if Nasdaq Operations changes the status of a
 // marketparticipant firm in an issue.
-struct MarketParticipationPos : public baseMessage {
-    public:
+struct MarketParticipationPos : public MessageBase<MarketParticipationPos> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    std::string mpid;
-    std::string stock;
+    char mpid[4];
+    char stock[8];
     char primaryMarketMaker;
     char marketMakerMode;
     char marketParticipantState;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        mpid = readString(file, 4);
-        stock = readStock(file);
-        file.read(&primaryMarketMaker, sizeof(primaryMarketMaker));
-        file.read(&marketMakerMode, sizeof(marketMakerMode));
-        file.read(&marketParticipantState, sizeof(marketParticipantState));
-    }
-
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "MPID -> " << mpid << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Primary Market Maker -> " << primaryMarketMaker << std::endl;
-        std::cout << "Market Maker Mode -> " << marketMakerMode << std::endl;
-        std::cout << "Market Participant State -> " << marketParticipantState << std::endl;
-    }
-
+template<>
+struct Schema<MarketParticipationPos>{
+    static constexpr char type = 'L';
+    static constexpr size_t size = 26;
+    static constexpr const char* title = "Market Participant Position";
+    static constexpr auto fields = std::tuple_cat(headerFields<MarketParticipationPos>(), std::make_tuple(
+        Field<&MarketParticipationPos::mpid, 11, 4>{"MPID"},
+        Field<&MarketParticipationPos::stock, 15, 8>{"Stock"},
+        Field<&MarketParticipationPos::primaryMarketMaker, 23, 1>{"Primary Market Maker"},
+        Field<&MarketParticipationPos::marketMakerMode, 24, 1>{"Market Maker Mode"},
+        Field<&MarketParticipationPos::marketParticipantState, 25, 1>{"Market Participant State"}
+    ));
 };
 
 
 // Informs data recipients what the daily MWCB breach points are set to for the current trading day.
-struct MWCBDecline : public baseMessage {
-    public:
+struct MWCBDecline : public MessageBase<MWCBDecline> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    uint64_t level1Raw, level2Raw, level3Raw;
-    double level1;
-    double level2;
-    double level3;
-
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        level1Raw = static_cast<uint64_t>(readBigEndianInteger(file, 8));
-        level2Raw = static_cast<uint64_t>(readBigEndianInteger(file, 8));
-        level3Raw = static_cast<uint64_t>(readBigEndianInteger(file, 8));
-        level1 = level1Raw / double(1e8);
-        level2 = level2Raw / double(1e8);
-        level3 = level3Raw / double(1e8);
-    }
-
-    void show() {
-            std::cout << "Stock Locate -> " << stockLocate << std::endl;
-            std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-            std::cout << "Timestamp -> " << timestamp << std::endl;
-            std::cout << "Level 1 -> " << level1 << std::endl;
-            std::cout << "Level 2 -> " << level2 << std::endl;
-            std::cout << "Level 3 -> " << level3 << std::endl;
-    }
+    uint64_t level1Raw;
+    uint64_t level2Raw;
+    uint64_t level3Raw;
+};
 
+template<>
+struct Schema<MWCBDecline>{
+    static constexpr char type = 'V';
+    static constexpr size_t size = 35;
+    static constexpr const char* title = "MWCB Decline Level";
+    static constexpr auto fields = std::tuple_cat(headerFields<MWCBDecline>(), std::make_tuple(
+        Field<&MWCBDecline::level1Raw, 11, 8, FieldKind::Price8>{"Level 1"},
+        Field<&MWCBDecline::level2Raw, 19, 8, FieldKind::Price8>{"Level 2"},
+        Field<&MWCBDecline::level3Raw, 27, 8, FieldKind::Price8>{"Level 3"}
+    ));
 };
 
 
 // Informs data recipients when a MWCB has breached one of the established levels
-struct MWCBStatus : public baseMessage {
-    public:
+struct MWCBStatus : public MessageBase<MWCBStatus> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     char breachedLevel;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        file.read(&breachedLevel, sizeof(breachedLevel));
-    }
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Breached Level -> " << breachedLevel << std::endl;
-    }
+template<>
+struct Schema<MWCBStatus>{
+    static constexpr char type = 'W';
+    static constexpr size_t size = 12;
+    static constexpr const char* title = "MWCB Status";
+    static constexpr auto fields = std::tuple_cat(headerFields<MWCBStatus>(), std::make_tuple(
+        Field<&MWCBStatus::breachedLevel, 11, 1>{"Breached Level"}
+    ));
 };
 
 
 // Indicates the anticipated IPO quotation release time of a security.
-struct QuotingPeriodUpdate : public baseMessage {
-    public:
+struct QuotingPeriodUpdate : public MessageBase<QuotingPeriodUpdate> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    std::string stock;
+    char stock[8];
     uint32_t ipoQuotationReleaseTime;
-    char ipoQuotationreleaseQualifier;
+    char ipoQuotationReleaseQualifier;
     uint32_t ipoPriceRaw;
-    double ipoPrice;
-
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        stock = readStock(file);
-        ipoQuotationReleaseTime = readBigEndianInteger(file, 4);
-        file.read(&ipoQuotationreleaseQualifier, sizeof(ipoQuotationreleaseQualifier));
-        ipoPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        ipoPrice = ipoPriceRaw / 10000.0;
-    }
-
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "IPO Quotation Release Time -> " << ipoQuotationReleaseTime << std::endl;
-        std::cout << "IPO Quotation Release Qualifier -> " << ipoQuotationreleaseQualifier << std::endl;
-        std::cout << "IPO Price -> " << ipoPrice << std::endl;
-    }
+};
+
+template<>
+struct Schema<QuotingPeriodUpdate>{
+    static constexpr char type = 'K';
+    static constexpr size_t size = 28;
+    static constexpr const char* title = "Quoting Period Update";
+    static constexpr auto fields = std::tuple_cat(headerFields<QuotingPeriodUpdate>(), std::make_tuple(
+        Field<&QuotingPeriodUpdate::stock, 11, 8>{"Stock"},
+        Field<&QuotingPeriodUpdate::ipoQuotationReleaseTime, 19, 4>{"IPO Quotation Release Time"},
+        Field<&QuotingPeriodUpdate::ipoQuotationReleaseQualifier, 23, 1>{"IPO Quotation Release Qualifier"},
+        Field<&QuotingPeriodUpdate::ipoPriceRaw, 24, 4, FieldKind::Price4>{"IPO Price"}
+    ));
 };
 
 
 //Indicates the auction collar thresholds within which a paused security can reopen following a LULD Trading Pause.
-struct LULDAuctionCollar : public baseMessage{
-    public:
+struct LULDAuctionCollar : public MessageBase<LULDAuctionCollar> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    std::string stock;
-    uint32_t auctionCollarRefPriceRaw, upperAuctionCollarPriceRaw, lowerAuctionCollarPriceRaw;
-    double auctionCollarRefPrice;
-    double upperAuctionCollarPrice;
-    double lowerAuctionCollarPrice;
+    char stock[8];
+    uint32_t auctionCollarRefPriceRaw;
+    uint32_t upperAuctionCollarPriceRaw;
+    uint32_t lowerAuctionCollarPriceRaw;
     uint32_t auctionCollarExtension;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        stock = readStock(file);
-        auctionCollarRefPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        upperAuctionCollarPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        lowerAuctionCollarPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        auctionCollarRefPrice = auctionCollarRefPriceRaw / 10000.0;
-        upperAuctionCollarPrice = upperAuctionCollarPriceRaw / 10000.0;
-        lowerAuctionCollarPrice = lowerAuctionCollarPriceRaw / 10000.0; 
-        file.read(reinterpret_cast<char*>(&auctionCollarExtension), sizeof(auctionCollarExtension));
-    }
-
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Auction Collar Reference Price -> " << auctionCollarRefPrice << std::endl;
-        std::cout << "Upper Auction Collar Price -> " << upperAuctionCollarPrice << std::endl;
-        std::cout << "Lower Auction Collar Price -> " << lowerAuctionCollarPrice << std::endl;
-        std::cout << "Auction Collar Extension -> " << auctionCollarExtension << std::endl;
-    }
-
+template<>
+struct Schema<LULDAuctionCollar>{
+    static constexpr char type = 'J';
+    static constexpr size_t size = 35;
+    static constexpr const char* title = "LULD Auction Collar";
+    static constexpr auto fields = std::tuple_cat(headerFields<LULDAuctionCollar>(), std::make_tuple(
+        Field<&LULDAuctionCollar::stock, 11, 8>{"Stock"},
+        Field<&LULDAuctionCollar::auctionCollarRefPriceRaw, 19, 4, FieldKind::Price4>{"Auction Collar Reference Price"},
+        Field<&LULDAuctionCollar::upperAuctionCollarPriceRaw, 23, 4, FieldKind::Price4>{"Upper Auction Collar Price"},
+        Field<&LULDAuctionCollar::lowerAuctionCollarPriceRaw, 27, 4, FieldKind::Price4>{"Lower Auction Collar Price"},
+        Field<&LULDAuctionCollar::auctionCollarExtension, 31, 4>{"Auction Collar Extension"}
+    ));
 };
 
+
 // The Exchange uses this message to indicate the current Operational Status of a security to the trading
 // community. An Operational Halt means that there has been an interruption of service on the identified
 // security impacting only the designated Market Center. These Halts differ from the “Stock Trading
@@ -399,123 +281,100 @@ struct LULDAuctionCollar : public baseMessage{
 // marketplace.
 // Nasdaq uses this administrative message to indicate the current trading status of the three market centers
 // operated by Nasdaq.
-struct OpeartionalHalt: public baseMessage{
-    public:
+struct OpeartionalHalt : public MessageBase<OpeartionalHalt> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
-    std::string stock;
+    char stock[8];
     char marketCode;
     char opeartionalHaltAction;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        stock = readStock(file);
-        file.read(&marketCode, sizeof(marketCode));
-        file.read(&opeartionalHaltAction, sizeof(opeartionalHaltAction));
-    }
-
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Market Code -> " << marketCode << std::endl;
-        std::cout << "Operational Halt Action -> " << opeartionalHaltAction << std::endl;
-    }
-
+template<>
+struct Schema<OpeartionalHalt>{
+    static constexpr char type = 'h';
+    static constexpr size_t size = 21;
+    static constexpr const char* title = "Operational Halt";
+    static constexpr auto fields = std::tuple_cat(headerFields<OpeartionalHalt>(), std::make_tuple(
+        Field<&OpeartionalHalt::stock, 11, 8>{"Stock"},
+        Field<&OpeartionalHalt::marketCode, 19, 1>{"Market Code"},
+        Field<&OpeartionalHalt::opeartionalHaltAction, 20, 1>{"Operational Halt Action"}
+    ));
 };
 
 
 // This message will be generated for unattributed orders accepted by the Nasdaq system. (Note: If a firm wants to
 // display a MPID for unattributed orders, Nasdaq recommends that it use the MPID of “NSDQ”.)
-struct AddOrderNoMPID : public baseMessage {
-    public:
+struct AddOrderNoMPID : public MessageBase<AddOrderNoMPID> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t orderRefNumber;
     char buySellIndicator;
     uint32_t shares;
-    std::string stock;
+    char stock[8];
     uint32_t priceRaw;
-    double price;
-
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        orderRefNumber = readBigEndianInteger(file, 8);
-        file.read(&buySellIndicator, sizeof(buySellIndicator));
-        shares = readBigEndianInteger(file, 4);
-        stock = readStock(file);
-        priceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        price = priceRaw / 10000.0;
-    }
-
-    void show() {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Order Reference Number -> " << orderRefNumber << std::endl;
-        std::cout << "Buy/Sell Indicator -> " << buySellIndicator << std::endl;
-        std::cout << "Shares -> " << shares << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Price -> " << price << std::endl;
-    }
+};
+
+template<>
+struct Schema<AddOrderNoMPID>{
+    static constexpr char type = 'A';
+    static constexpr size_t size = 36;
+    static constexpr const char* title = "Add Order (No MPID Attribution)";
+    static constexpr auto fields = std::tuple_cat(headerFields<AddOrderNoMPID>(), std::make_tuple(
+        Field<&AddOrderNoMPID::orderRefNumber, 11, 8>{"Order Reference Number"},
+        Field<&AddOrderNoMPID::buySellIndicator, 19, 1>{"Buy/Sell Indicator"},
+        Field<&AddOrderNoMPID::shares, 20, 4>{"Shares"},
+        Field<&AddOrderNoMPID::stock, 24, 8>{"Stock"},
+        Field<&AddOrderNoMPID::priceRaw, 32, 4, FieldKind::Price4>{"Price"}
+    ));
 };
 
 
 // This message will be generated for attributed orders and quotations accepted by the Nasdaq system.
-struct AddOrderWithMPID : public AddOrderNoMPID {
-    public:
-    std::string attribution;
-    void load(std::ifstream &file){
-        AddOrderNoMPID::load(file);
-        attribution = readString(file, 4);
-    }
+struct AddOrderWithMPID : public AddOrderNoMPID, public MessageBase<AddOrderWithMPID> {
+    using MessageBase<AddOrderWithMPID>::load;
+    using MessageBase<AddOrderWithMPID>::show;
 
-    void show() override {
-        AddOrderNoMPID::show();
-        std::cout << "Attribution -> " << attribution << std::endl;
-    }
+    char attribution[4];
+};
 
+template<>
+struct Schema<AddOrderWithMPID>{
+    static constexpr char type = 'F';
+    static constexpr size_t size = 40;
+    static constexpr const char* title = "Add Order (MPID Attribution)";
+    static constexpr auto fields = std::tuple_cat(Schema<AddOrderNoMPID>::fields, std::make_tuple(
+        Field<&AddOrderWithMPID::attribution, 36, 4>{"Attribution"}
+    ));
 };
 
+
 // This message is sent whenever an orderon the book is executed in whole or in part. It is possible to receive several
 // Order Executed Messages for the same order reference number if that order is executed in several parts. The
 // multiple Order Executed Messages on the same order are cumulative.
-struct OrderExecuted : public baseMessage {
-    public:
+struct OrderExecuted : public MessageBase<OrderExecuted> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t orderRefNumber;
     uint32_t executedShares;
     uint64_t matchNumber;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        orderRefNumber = readBigEndianInteger(file, 8);
-        executedShares = readBigEndianInteger(file, 4);
-        matchNumber = readBigEndianInteger(file, 8);
-    }
-
-    void show()  {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Order Reference Number -> " << orderRefNumber << std::endl;
-        std::cout << "Executed Shares -> " << executedShares << std::endl;
-        std::cout << "Match Number -> " << matchNumber << std::endl;
-    }
-
+template<>
+struct Schema<OrderExecuted>{
+    static constexpr char type = 'E';
+    static constexpr size_t size = 31;
+    static constexpr const char* title = "Order Executed";
+    static constexpr auto fields = std::tuple_cat(headerFields<OrderExecuted>(), std::make_tuple(
+        Field<&OrderExecuted::orderRefNumber, 11, 8>{"Order Reference Number"},
+        Field<&OrderExecuted::executedShares, 19, 4>{"Executed Shares"},
+        Field<&OrderExecuted::matchNumber, 23, 8>{"Match Number"}
+    ));
 };
 
+
 // This message issent whenever an order on the book is executed in whole or in part at a price different from the
 // initial display price. Since the execution price is different than the display price of the original Add Order,Nasdaq
 // includes a pricefieldwithin this executionmessage.
@@ -525,76 +384,64 @@ struct OrderExecuted : public baseMessage {
 // shares will be included into a later bulk print (e.g., in the case of cross executions). If a firm is looking to use the data
 // in time-•-and-•-sales displays or volume calculations, Nasdaq recommends that firms ignore messages marked as non-
 // -- printable to prevent double counting.
-struct OrderExecutedWithPrice : public OrderExecuted {
-    public:
+struct OrderExecutedWithPrice : public OrderExecuted, public MessageBase<OrderExecutedWithPrice> {
+    using MessageBase<OrderExecutedWithPrice>::load;
+    using MessageBase<OrderExecutedWithPrice>::show;
+
     char printable;
     uint32_t executionPriceRaw;
-    double executionPrice;
-
-    void load(std::ifstream &file){
-        OrderExecuted::load(file);
-        file.read(&printable, sizeof(printable));
-        executionPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        executionPrice = executionPriceRaw / 10000.0;
-    }
+};
 
-    void show() override {
-        OrderExecuted::show();
-        std::cout << "Printable -> " << printable << std::endl;
-        std::cout << "Execution Price -> " << executionPrice << std::endl;
-    }
+template<>
+struct Schema<OrderExecutedWithPrice>{
+    static constexpr char type = 'C';
+    static constexpr size_t size = 36;
+    static constexpr const char* title = "Order Executed With Price";
+    static constexpr auto fields = std::tuple_cat(Schema<OrderExecuted>::fields, std::make_tuple(
+        Field<&OrderExecutedWithPrice::printable, 31, 1>{"Printable"},
+        Field<&OrderExecutedWithPrice::executionPriceRaw, 32, 4, FieldKind::Price4>{"Execution Price"}
+    ));
 };
 
 
 // This message is sent whenever an order on the book is modified as a result of a partial cancellation.
-struct OrderCancel : public baseMessage {
-    public: 
+struct OrderCancel : public MessageBase<OrderCancel> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t orderRefNumber;
     uint32_t cancelledShares;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        orderRefNumber = readBigEndianInteger(file, 8);
-        cancelledShares = readBigEndianInteger(file, 4);
-    }
-
-    void show() override {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Order Reference Number -> " << orderRefNumber << std::endl;
-        std::cout << "Cancelled Shares -> " << cancelledShares << std::endl;
-    }
+template<>
+struct Schema<OrderCancel>{
+    static constexpr char type = 'X';
+    static constexpr size_t size = 23;
+    static constexpr const char* title = "Order Cancel";
+    static constexpr auto fields = std::tuple_cat(headerFields<OrderCancel>(), std::make_tuple(
+        Field<&OrderCancel::orderRefNumber, 11, 8>{"Order Reference Number"},
+        Field<&OrderCancel::cancelledShares, 19, 4>{"Cancelled Shares"}
+    ));
 };
 
 
 // This message is sent whenever an order on the book is being cancelled. All remaining shares are no longer
 // accessible so the order must be removed from the book.
-struct OrderDelete : public baseMessage {
-    public:
+struct OrderDelete : public MessageBase<OrderDelete> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t orderRefNumber;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        orderRefNumber = readBigEndianInteger(file, 8);
-    }
-
-    void show()  {
-    std::cout << "Stock Locate -> " << stockLocate << std::endl;
-    std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-    std::cout << "Timestamp -> " << timestamp << std::endl;
-    std::cout << "Order Reference Number -> " << orderRefNumber << std::endl;
-    }
+template<>
+struct Schema<OrderDelete>{
+    static constexpr char type = 'D';
+    static constexpr size_t size = 19;
+    static constexpr const char* title = "Order Delete";
+    static constexpr auto fields = std::tuple_cat(headerFields<OrderDelete>(), std::make_tuple(
+        Field<&OrderDelete::orderRefNumber, 11, 8>{"Order Reference Number"}
+    ));
 };
 
 
@@ -603,7 +450,7 @@ struct OrderDelete : public baseMessage {
 // replacement, along with a new order reference number which will be used henceforth. Since the side, stock
 // symbol and attribution(if any) cannot be changed by an OrderReplace event,these fields are not included in the
 // message. Firms should retain the side, stock symbol and MPID from the original Add Order message.
-struct OrderReplace : public baseMessage {
+struct OrderReplace : public MessageBase<OrderReplace> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
@@ -611,31 +458,19 @@ struct OrderReplace : public baseMessage {
     uint64_t newOrderRefNumber;
     uint32_t shares;
     uint32_t priceRaw;
-    double price;
-
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        originalOrderRefNumber = readBigEndianInteger(file, 8);
-        newOrderRefNumber = readBigEndianInteger(file, 8);
-        shares = readBigEndianInteger(file, 4);
-        priceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        price = priceRaw / 10000.0;
-    }
-
-    void show() {
-        
-        std::cout << "Stock Locate: " << stockLocate << std::endl;
-        std::cout << "Tracking Number: " << trackingNumber << std::endl;
-        std::cout << "Timestamp: " << timestamp << std::endl;
-        std::cout << "Original Order Reference Number: " << originalOrderRefNumber << std::endl;
-        std::cout << "New Order Reference Number: " << newOrderRefNumber << std::endl;
-        std::cout << "Shares: " << shares << std::endl;
-        std::cout << "Price Raw: " << priceRaw << std::endl;
-        std::cout << "Price: " << price << std::endl;
-    }
+};
 
+template<>
+struct Schema<OrderReplace>{
+    static constexpr char type = 'U';
+    static constexpr size_t size = 35;
+    static constexpr const char* title = "Order Replace";
+    static constexpr auto fields = std::tuple_cat(headerFields<OrderReplace>(), std::make_tuple(
+        Field<&OrderReplace::originalOrderRefNumber, 11, 8>{"Original Order Reference Number"},
+        Field<&OrderReplace::newOrderRefNumber, 19, 8>{"New Order Reference Number"},
+        Field<&OrderReplace::shares, 27, 4>{"Shares"},
+        Field<&OrderReplace::priceRaw, 31, 4, FieldKind::Price4>{"Price"}
+    ));
 };
 
 
@@ -649,44 +484,31 @@ struct OrderReplace : public baseMessage {
 // Trade Messages should be included in Nasdaq time-•-and-•-sales displays as well as volume and other market
 // statistics. Since Trade Messages do not affect the book, however, they may be ignored by firms just looking to build
 // and track the Nasdaq execution system display.
-struct NonCrossTrade : public baseMessage{
-    
-    public:
+struct NonCrossTrade : public MessageBase<NonCrossTrade> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t orderRefNumber;
     char buySellIndicator;
     uint32_t shares;
-    std::string stock;
+    char stock[8];
     uint32_t priceRaw;
-    double price;
     uint64_t matchNumber;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        orderRefNumber = readBigEndianInteger(file, 8);
-        file.read(&buySellIndicator, sizeof(buySellIndicator));
-        shares = readBigEndianInteger(file, 4);
-        stock = readStock(file);
-        priceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        price = priceRaw / 10000.0;
-        matchNumber = readBigEndianInteger(file, 8);
-    }
-
-    void show(){
-        std::cout << "Stock Locator -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Order Reference Number -> " << orderRefNumber << std::endl;
-        std::cout << "Buy/Sell Indicator -> " << buySellIndicator << std::endl;
-        std::cout << "Shares -> " << shares << std::endl;
-        std::cout << "Stock Name -> " << stock << std::endl;
-        std::cout << "Price -> " << price << std::endl;
-        std::cout << "Match Number -> " << matchNumber << std::endl;
-    }
+template<>
+struct Schema<NonCrossTrade>{
+    static constexpr char type = 'P';
+    static constexpr size_t size = 44;
+    static constexpr const char* title = "Trade (Non-Cross)";
+    static constexpr auto fields = std::tuple_cat(headerFields<NonCrossTrade>(), std::make_tuple(
+        Field<&NonCrossTrade::orderRefNumber, 11, 8>{"Order Reference Number"},
+        Field<&NonCrossTrade::buySellIndicator, 19, 1>{"Buy/Sell Indicator"},
+        Field<&NonCrossTrade::shares, 20, 4>{"Shares"},
+        Field<&NonCrossTrade::stock, 24, 8>{"Stock"},
+        Field<&NonCrossTrade::priceRaw, 32, 4, FieldKind::Price4>{"Price"},
+        Field<&NonCrossTrade::matchNumber, 36, 8>{"Match Number"}
+    ));
 };
 
 
@@ -700,40 +522,29 @@ struct NonCrossTrade : public baseMessage{
 // shares as zero.
 // To avoid double counting of cross volume, firms should not include transactions marked as non-•-printable in time---
 // and-•-sales displays or market statistic calculations.
-struct CrossTrade : public baseMessage {
-
-    public:
+struct CrossTrade : public MessageBase<CrossTrade> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t shares;
-    std::string stock;
+    char stock[8];
     uint32_t crossPriceRaw;
-    double crossPrice;
     uint64_t matchNumber;
     char crossType;
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        shares = readBigEndianInteger(file, 8);
-        stock = readStock(file);
-        crossPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        crossPrice = crossPriceRaw / 10000.0;
-        matchNumber = readBigEndianInteger(file, 8);
-        file.read(&crossType, sizeof(crossType));
-    }
-    void show()  {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Shares -> " << shares << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Cross Price -> " << crossPrice << std::endl;
-        std::cout << "Match Number -> " << matchNumber << std::endl;
-        std::cout << "Cross Type -> " << crossType << std::endl;
-    }
+template<>
+struct Schema<CrossTrade>{
+    static constexpr char type = 'Q';
+    static constexpr size_t size = 40;
+    static constexpr const char* title = "Cross Trade";
+    static constexpr auto fields = std::tuple_cat(headerFields<CrossTrade>(), std::make_tuple(
+        Field<&CrossTrade::shares, 11, 8>{"Shares"},
+        Field<&CrossTrade::stock, 19, 8>{"Stock"},
+        Field<&CrossTrade::crossPriceRaw, 27, 4, FieldKind::Price4>{"Cross Price"},
+        Field<&CrossTrade::matchNumber, 31, 8>{"Match Number"},
+        Field<&CrossTrade::crossType, 39, 1>{"Cross Type"}
+    ));
 };
 
 
@@ -743,80 +554,166 @@ struct CrossTrade : public baseMessage {
 // Firms that use the ITCH feed to create time---and---sales displays or calculate market statistics should be prepared
 // to process the broken trade message. If a firm is only using the ITCH feed to build a book, however, it may ignore
 // these messages as they have no impact on the current book.
-struct BrokenTrade : baseMessage {
-
-    public:
+struct BrokenTrade : public MessageBase<BrokenTrade> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t matchNumber;
-
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        matchNumber = readBigEndianInteger(file, 8);
-    }
-
-    void show() {
-    std::cout << "Stock Locate -> " << stockLocate << std::endl;
-    std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-    std::cout << "Timestamp -> " << timestamp << std::endl;
-    std::cout << "Match Number -> " << matchNumber << std::endl;
-}
 };
 
-struct NetOrderImbalance : public baseMessage {
+template<>
+struct Schema<BrokenTrade>{
+    static constexpr char type = 'B';
+    static constexpr size_t size = 19;
+    static constexpr const char* title = "Broken Trade";
+    static constexpr auto fields = std::tuple_cat(headerFields<BrokenTrade>(), std::make_tuple(
+        Field<&BrokenTrade::matchNumber, 11, 8>{"Match Number"}
+    ));
+};
 
-    uint32_t farPriceRaw, nearPriceRaw, currRefPrceRaw;
 
-    public:
+// Sent ahead of the Nasdaq opening, closing and IPO / halt crosses with the paired and imbalance shares and the
+// indicative clearing prices of the cross.
+struct NetOrderImbalance : public MessageBase<NetOrderImbalance> {
     uint16_t stockLocate;
     uint16_t trackingNumber;
     uint64_t timestamp;
     uint64_t pairedShares;
     uint64_t imbalanceShares;
     char imbalanceDirection;
-    std::string stock;
-    double farPrice;
-    double nearPrice;
-    double currRefPrice;
+    char stock[8];
+    uint32_t farPriceRaw;
+    uint32_t nearPriceRaw;
+    uint32_t currRefPriceRaw;
     char crossType;
     char priceVariationIndicator;
+};
 
+template<>
+struct Schema<NetOrderImbalance>{
+    static constexpr char type = 'I';
+    static constexpr size_t size = 50;
+    static constexpr const char* title = "Net Order Imbalance Indicator (NOII)";
+    static constexpr auto fields = std::tuple_cat(headerFields<NetOrderImbalance>(), std::make_tuple(
+        Field<&NetOrderImbalance::pairedShares, 11, 8>{"Paired Shares"},
+        Field<&NetOrderImbalance::imbalanceShares, 19, 8>{"Imbalance Shares"},
+        Field<&NetOrderImbalance::imbalanceDirection, 27, 1>{"Imbalance Direction"},
+        Field<&NetOrderImbalance::stock, 28, 8>{"Stock"},
+        Field<&NetOrderImbalance::farPriceRaw, 36, 4, FieldKind::Price4>{"Far Price"},
+        Field<&NetOrderImbalance::nearPriceRaw, 40, 4, FieldKind::Price4>{"Near Price"},
+        Field<&NetOrderImbalance::currRefPriceRaw, 44, 4, FieldKind::Price4>{"Current Reference Price"},
+        Field<&NetOrderImbalance::crossType, 48, 1>{"Cross Type"},
+        Field<&NetOrderImbalance::priceVariationIndicator, 49, 1>{"Price Variation Indicator"}
+    ));
+};
+
+
+// Disseminated for Direct Listings with a Capital Raise (DLCR) during the price discovery of the opening cross.
+struct DirectListingPriceDiscovery : public MessageBase<DirectListingPriceDiscovery> {
+    uint16_t stockLocate;
+    uint16_t trackingNumber;
+    uint64_t timestamp;
+    char stock[8];
+    char openEligibilityStatus;
+    uint32_t minAllowablePriceRaw;
+    uint32_t maxAllowablePriceRaw;
+    uint32_t nearExecutionPriceRaw;
+    uint64_t nearExecutionTime;
+    uint32_t lowerPriceRangeCollarRaw;
+    uint32_t upperPriceRangeCollarRaw;
+};
+
+template<>
+struct Schema<DirectListingPriceDiscovery>{
+    static constexpr char type = 'O';
+    static constexpr size_t size = 48;
+    static constexpr const char* title = "Direct Listing with Capital Raise Price Discovery";
+    static constexpr auto fields = std::tuple_cat(headerFields<DirectListingPriceDiscovery>(), std::make_tuple(
+        Field<&DirectListingPriceDiscovery::stock, 11, 8>{"Stock"},
+        Field<&DirectListingPriceDiscovery::openEligibilityStatus, 19, 1>{"Open Eligibility Status"},
+        Field<&DirectListingPriceDiscovery::minAllowablePriceRaw, 20, 4, FieldKind::Price4>{"Minimum Allowable Price"},
+        Field<&DirectListingPriceDiscovery::maxAllowablePriceRaw, 24, 4, FieldKind::Price4>{"Maximum Allowable Price"},
+        Field<&DirectListingPriceDiscovery::nearExecutionPriceRaw, 28, 4, FieldKind::Price4>{"Near Execution Price"},
+        Field<&DirectListingPriceDiscovery::nearExecutionTime, 32, 8>{"Near Execution Time"},
+        Field<&DirectListingPriceDiscovery::lowerPriceRangeCollarRaw, 40, 4, FieldKind::Price4>{"Lower Price Range Collar"},
+        Field<&DirectListingPriceDiscovery::upperPriceRangeCollarRaw, 44, 4, FieldKind::Price4>{"Upper Price Range Collar"}
+    ));
+};
 
-    void load(std::ifstream &file){
-        stockLocate = readBigEndianInteger(file, 2);
-        trackingNumber = readBigEndianInteger(file, 2);
-        timestamp = readBigEndianInteger(file, 6);
-        pairedShares = readBigEndianInteger(file, 8);
-        imbalanceShares = readBigEndianInteger(file, 8);
-        file.read(&imbalanceDirection, sizeof(imbalanceDirection));
-        stock = readStock(file);
-        farPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        nearPriceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        currRefPrceRaw = static_cast<uint32_t>(readBigEndianInteger(file, 4));
-        farPrice = farPriceRaw / 10000.0;
-        nearPrice = nearPrice / 10000.0;
-        currRefPrice = currRefPrceRaw / 10000.0;
-        file.read(&crossType, sizeof(crossType));
-        file.read(&priceVariationIndicator, sizeof(priceVariationIndicator));
-    }
-
-    void show()  {
-        std::cout << "Stock Locate -> " << stockLocate << std::endl;
-        std::cout << "Tracking Number -> " << trackingNumber << std::endl;
-        std::cout << "Timestamp -> " << timestamp << std::endl;
-        std::cout << "Paired Shares -> " << pairedShares << std::endl;
-        std::cout << "Imbalance Shares -> " << imbalanceShares << std::endl;
-        std::cout << "Imbalance Direction -> " << imbalanceDirection << std::endl;
-        std::cout << "Stock -> " << stock << std::endl;
-        std::cout << "Far Price -> " << farPrice << std::endl;
-        std::cout << "Near Price -> " << nearPrice << std::endl;
-        std::cout << "Current Reference Price -> " << currRefPrice << std::endl;
-        std::cout << "Cross Type -> " << crossType << std::endl;
-        std::cout << "Price Variation Indicator -> " << priceVariationIndicator << std::endl;
-    }
-};
-
-                    
\ No newline at end of file
+
+// Indicates the presence of Retail Price Improvement (RPI) interest on the bid and / or offer side of a security.
+struct RetailPriceImprovement : public MessageBase<RetailPriceImprovement> {
+    uint16_t stockLocate;
+    uint16_t trackingNumber;
+    uint64_t timestamp;
+    char stock[8];
+    char interestFlag;
+};
+
+template<>
+struct Schema<RetailPriceImprovement>{
+    static constexpr char type = 'N';
+    static constexpr size_t size = 20;
+    static constexpr const char* title = "Retail Price Improvement Indicator (RPII)";
+    static constexpr auto fields = std::tuple_cat(headerFields<RetailPriceImprovement>(), std::make_tuple(
+        Field<&RetailPriceImprovement::stock, 11, 8>{"Stock"},
+        Field<&RetailPriceImprovement::interestFlag, 19, 1>{"Interest Flag"}
+    ));
+};
+
+
+// All ITCH 5.0 message types, adding one is a struct, its Schema and an entry here.
+using MessageTypes = std::tuple<
+    SystemEvent,
+    StockDirectory,
+    StockTradingAction,
+    RegSHOShortSalePriceTestIndicator,
+    MarketParticipationPos,
+    MWCBDecline,
+    MWCBStatus,
+    QuotingPeriodUpdate,
+    LULDAuctionCollar,
+    OpeartionalHalt,
+    AddOrderNoMPID,
+    AddOrderWithMPID,
+    OrderExecuted,
+    OrderExecutedWithPrice,
+    OrderCancel,
+    OrderDelete,
+    OrderReplace,
+    NonCrossTrade,
+    CrossTrade,
+    BrokenTrade,
+    NetOrderImbalance,
+    DirectListingPriceDiscovery,
+    RetailPriceImprovement
+>;
+
+
+template<typename... Messages>
+std::map<char, int> payloadSizes(std::tuple<Messages...>*){
+    return {{Schema<Messages>::type, int(Schema<Messages>::size - 1)}...};
+}
+
+// Message sizes without the type byte, keyed by type.
+const std::map<char, int> packet_sizes = payloadSizes(static_cast<MessageTypes*>(nullptr));
+
+
+template<typename Message, typename F>
+inline void decodeAndCall(const char* message, F& fn){
+    Message msg;
+    decodeMessage(message, msg);
+    fn(msg);
+}
+
+template<typename F, typename... Messages>
+inline bool visitMessageOf(const char* message, F& fn, std::tuple<Messages...>*){
+    return ((message[0] == Schema<Messages>::type && (decodeAndCall<Messages>(message, fn), true)) || ...);
+}
+
+// Decodes message (type byte first) into the struct of its type and calls fn with it.
+// Returns false for types outside ITCH 5.0.
+template<typename F>
+inline bool visitMessage(const char* message, F&& fn){
+    return visitMessageOf(message, fn, static_cast<MessageTypes*>(nullptr));
+}
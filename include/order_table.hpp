@@ -0,0 +1,172 @@
+#ifndef ORDER_TABLE_HPP
+#define ORDER_TABLE_HPP
+#endif
+
+#pragma once
+
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <memory_resource>
+
+
+// A resting order as the Parser keeps it, the price in dollars like the stored trades.
+struct RestingOrder{
+    uint64_t timestamp;
+    uint32_t shares;
+    double price;
+};
+
+
+// One symbol's resting orders keyed by order reference number. Open addressing with linear probing
+// and backward shift deletion, so a lookup usually touches a single 32 byte slot whose address
+// follows from the key alone. prefetch() can therefore pull the slot into cache several messages
+// ahead of the lookup, which the pointer chasing of a std::map does not allow.
+class OrderTable{
+    struct Slot{
+        // 0 marks an empty slot, order reference 0 is kept in zeroOrder.
+        uint64_t key;
+        RestingOrder order;
+    };
+
+    static constexpr size_t initialCapacity = 16;
+
+    std::pmr::vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
+    bool hasZero = false;
+    RestingOrder zeroOrder{};
+
+    // Order reference numbers are nearly sequential, Fibonacci hashing spreads them over the table.
+    size_t home(uint64_t key) const {
+        return size_t((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    }
+
+    Slot* findSlot(uint64_t key){
+        if(slots.empty()){
+            return nullptr;
+        }
+        for(size_t i = home(key); ; i = (i + 1) & mask){
+            if(slots[i].key == key){
+                return &slots[i];
+            }
+            if(slots[i].key == 0){
+                return nullptr;
+            }
+        }
+    }
+
+    void grow(){
+        std::pmr::vector<Slot> old(slots.size() ? slots.size() * 2 : initialCapacity, Slot{}, slots.get_allocator());
+        old.swap(slots);
+        mask = slots.size() - 1;
+        for(const Slot& slot : old){
+            if(slot.key){
+                size_t i = home(slot.key);
+                while(slots[i].key){
+                    i = (i + 1) & mask;
+                }
+                slots[i] = slot;
+            }
+        }
+    }
+
+    public:
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    explicit OrderTable(const allocator_type& allocator = {}) : slots(allocator) {}
+
+    OrderTable(const OrderTable& other, const allocator_type& allocator)
+        : slots(other.slots, allocator), mask(other.mask), count(other.count), hasZero(other.hasZero), zeroOrder(other.zeroOrder) {}
+
+    RestingOrder* find(uint64_t orderRefNumber){
+        if(orderRefNumber == 0){
+            return hasZero ? &zeroOrder : nullptr;
+        }
+        Slot* slot = findSlot(orderRefNumber);
+        return slot ? &slot->order : nullptr;
+    }
+
+    // False, and nothing changes, when the order is already present.
+    bool insert(uint64_t orderRefNumber, const RestingOrder& order){
+        if(orderRefNumber == 0){
+            if(hasZero){
+                return false;
+            }
+            hasZero = true;
+            zeroOrder = order;
+            count++;
+            return true;
+        }
+        // At most half full, so probe runs, and with them lookups of absent orders and erases, stay short.
+        if(2 * (count + 1) > slots.size()){
+            grow();
+        }
+        size_t i = home(orderRefNumber);
+        for(; slots[i].key; i = (i + 1) & mask){
+            if(slots[i].key == orderRefNumber){
+                return false;
+            }
+        }
+        slots[i] = Slot{orderRefNumber, order};
+        count++;
+        return true;
+    }
+
+    void insertOrAssign(uint64_t orderRefNumber, const RestingOrder& order){
+        if(RestingOrder* existing = find(orderRefNumber)){
+            *existing = order;
+            return;
+        }
+        insert(orderRefNumber, order);
+    }
+
+    bool erase(uint64_t orderRefNumber){
+        if(orderRefNumber == 0){
+            count -= hasZero;
+            return std::exchange(hasZero, false);
+        }
+        Slot* slot = findSlot(orderRefNumber);
+        if(!slot){
+            return false;
+        }
+        // Backward shift: pull later members of the probe run into the hole, no tombstones.
+        size_t hole = size_t(slot - slots.data());
+        for(size_t i = (hole + 1) & mask; slots[i].key; i = (i + 1) & mask){
+            if(((i - home(slots[i].key)) & mask) >= ((i - hole) & mask)){
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole].key = 0;
+        count--;
+        return true;
+    }
+
+    void prefetch(uint64_t orderRefNumber) const {
+        if(!slots.empty()){
+            __builtin_prefetch(&slots[home(orderRefNumber)]);
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // (order reference, order) pairs in order reference order, for output.
+    std::vector<std::pair<uint64_t, RestingOrder>> sorted() const {
+        std::vector<std::pair<uint64_t, RestingOrder>> entries;
+        entries.reserve(count);
+        if(hasZero){
+            entries.push_back({0, zeroOrder});
+        }
+        for(const Slot& slot : slots){
+            if(slot.key){
+                entries.push_back({slot.key, slot.order});
+            }
+        }
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+        return entries;
+    }
+};
@@ -10,11 +10,44 @@
 #include <vector>
 #include <cstring>
 #include <map>
+#include <memory_resource>
 #include <variant>
+#include <memory>
+#include <filesystem>
+#include <sstream>
+#include <numeric>
+#include <cmath>
+#include <algorithm>
+#include <functional>
 #include "message.hpp"
+#include "bbo.hpp"
+#include "async_writer.hpp"
+#include "arena.hpp"
+#include "thread_pool.hpp"
+#include "trade_tape.hpp"
+#include "order_table.hpp"
+#include "alloc_trace.hpp"
+#include "decoder.hpp"
+#include "book_history.hpp"
+#include "feed_merger.hpp"
+#include "follow.hpp"
+#include "live_vwap.hpp"
+#include "perf_counters.hpp"
+#include "mapped_file.hpp"
+#include "external_sort.hpp"
+#include "result_cache.hpp"
+#include "catch_up.hpp"
 
 
 using Data = std::variant<char, uint16_t, uint32_t, uint64_t, double>;
+using DataRow = std::pmr::vector<Data>;
+
+// All Parser state is allocated from one std::pmr::memory_resource.
+using SymbolTable = std::pmr::map<uint16_t, std::pmr::string>;
+using DataBook = std::pmr::map<uint16_t, std::pmr::map<uint64_t, DataRow>>;
+using OrderBook = std::pmr::map<uint16_t, OrderTable>;
+using HourlyPV = std::pmr::map<uint16_t, std::pmr::map<uint16_t, std::pmr::vector<std::pair<double, uint64_t>>>>;
+using HourlyVWAP = std::pmr::map<uint16_t, std::pmr::map<uint16_t, double>>;
 
 
 class Parser{
@@ -23,18 +56,61 @@ class Parser{
     std::string rawTradesFilePath = "/workspaces/itch-5.0-processing/raw/raw_trades.csv";
     std::string openOrdersFilePath = "/workspaces/itch-5.0-processing/raw/open_orders.csv";
     std::string finalVWAPFilePath = "/workspaces/itch-5.0-processing/itch_vwap.csv";
-    std::map<uint16_t, std::string>stockMap;
-    std::map<uint16_t, std::map<uint64_t, std::vector<Data>>> orders, trades;
+    std::pmr::memory_resource* resource;
+    // Set when resource is a ParserArena, the containers are then abandoned instead of destroyed.
+    ParserArena* arena;
+    SymbolTable stockMap;
+    OrderBook orders;
+    // orders' tables by stock locate, map nodes never move
+    std::vector<OrderTable*> orderTables;
+    DataBook trades;
     // std::map<uint16_t, std::map<uint8_t, std::vector<std::vector<Data>>>> processedTrades;
-    std::map<uint16_t, std::map<uint16_t, std::vector<std::pair<double, uint64_t>>>>pv;
-    std::map<uint16_t, std::map<uint16_t, double>>vwapMap;
+    HourlyPV pv;
+    HourlyVWAP vwapMap;
+    // Replaces trades when compactTrades is set, see enableCompactTrades()
+    TradeTape tradeTape;
+    bool compactTrades = false;
+    BBOTracker* bbo = nullptr;
+    BookSnapshotWriter* snapshots = nullptr;
+    LiveVWAP* live = nullptr;
+    StageProfiler* profiler = nullptr;
+    CatchUpMonitor* catchUp = nullptr;
+    // BBO conflation interval to restore when catching up ends
+    uint64_t bboConflationMicros = 0;
+    WorkStealingPool* pool = nullptr;
+    bool pipelined = false;
+    // Events decoded but not applied yet, see enableLookahead()
+    std::vector<Event> window;
+    size_t windowCount = 0;
+    // Shard of a multi-process run, see setLocateRange()
+    uint16_t firstLocate = 0;
+    uint16_t lastLocate = UINT16_MAX;
+    std::function<void(const VWAPRecord&)> vwapConsumer;
+
+    // Incremental hourly output, see enableIncrementalOutput()
+    struct RunningVWAP{
+        double pv = 0.0;
+        uint64_t volume = 0;
+        uint16_t activeHour = 0;
+    };
+    bool incremental = false;
+    uint16_t currentHour = 0;
+    std::vector<RunningVWAP> runningVWAP;
+    std::vector<uint16_t> activeSymbols;
+    std::ofstream incrementalVWAP;
+    std::unique_ptr<AsyncWriter<VWAPRecord>> incrementalSink;
+    std::unique_ptr<AsyncWriter<VWAPRecord>> vwapSink;
+    std::unique_ptr<AsyncWriter<RawInfoRecord>> rawTradesSink, openOrdersSink;
+    bool asyncOutput = false;
+    OutputFormat asyncFormat = OutputFormat::CSV;
+    BackpressurePolicy asyncPolicy = BackpressurePolicy::Block;
 
-    std::pair<double, uint64_t> fetchPV(std::vector<Data>& execTrade){
-            double* price = std::get_if<double>(&execTrade[2]);
-            if(uint64_t* vol = std::get_if<uint64_t>(&execTrade[1])){
+    static std::pair<double, uint64_t> fetchPV(const DataRow& execTrade){
+            const double* price = std::get_if<double>(&execTrade[2]);
+            if(const uint64_t* vol = std::get_if<uint64_t>(&execTrade[1])){
                 return {(*vol) * (*price), (*vol)};
             }
-            else if(uint32_t* vol = std::get_if<uint32_t>(&execTrade[1])){
+            else if(const uint32_t* vol = std::get_if<uint32_t>(&execTrade[1])){
                 return {(*vol) * (*price), (*vol)};
             }
             else{
@@ -43,7 +119,66 @@ class Parser{
             }
         }
 
+    static uint64_t toUInt(const Data& value){
+        return std::visit([](auto&& v) -> uint64_t { return static_cast<uint64_t>(v); }, value);
+    }
+
+    static RawInfoRecord toRawInfoRecord(const std::pmr::string& name, const DataRow& info){
+        RawInfoRecord record;
+        copySymbol(record.name, name);
+        record.timestamp = toUInt(info[0]);
+        record.volume = toUInt(info[1]);
+        record.price = std::get<double>(info[2]);
+        return record;
+    }
+
+    static RawInfoRecord toRawInfoRecord(const std::pmr::string& name, const RestingOrder& order){
+        RawInfoRecord record;
+        copySymbol(record.name, name);
+        record.timestamp = order.timestamp;
+        record.volume = order.shares;
+        record.price = order.price;
+        return record;
+    }
+
+    std::string asyncOutputPath(const std::string& path) const {
+        return asyncFormat == OutputFormat::Binary ? std::filesystem::path(path).replace_extension(".bin").string() : path;
+    }
+
+    void writeRawInfoAsync(){
+        rawTradesSink = std::make_unique<AsyncWriter<RawInfoRecord>>(asyncOutputPath(rawTradesFilePath), asyncFormat, asyncPolicy);
+        openOrdersSink = std::make_unique<AsyncWriter<RawInfoRecord>>(asyncOutputPath(openOrdersFilePath), asyncFormat, asyncPolicy);
+        for(auto& [stockLocate, stockTrades] : trades){
+            const std::pmr::string& name = stockMap[stockLocate];
+            for(auto& [matchNumber, trade] : stockTrades){
+                rawTradesSink->push(toRawInfoRecord(name, trade));
+            }
+        }
+        RawInfoRecord record;
+        for(auto& [stockLocate, stockTrades] : tradeTape){
+            copySymbol(record.name, stockMap[stockLocate]);
+            for(const TapeTrade& trade : stockTrades){
+                record.timestamp = trade.timestamp;
+                record.volume = trade.shares;
+                record.price = trade.price / 10000.0;
+                rawTradesSink->push(record);
+            }
+        }
+        for(auto& [stockLocate, stockOrders] : orders){
+            const std::pmr::string& name = stockMap[stockLocate];
+            for(auto& [orderRefNumber, order] : stockOrders.sorted()){
+                openOrdersSink->push(toRawInfoRecord(name, order));
+            }
+        }
+        orders.clear();
+        orderTables.clear();
+    }
+
     void writeRawInfo(){
+        if(asyncOutput){
+            writeRawInfoAsync();
+            return;
+        }
 
         std::ofstream rawTrades;
         std::ofstream openOrders;
@@ -70,24 +205,58 @@ class Parser{
             }
         }
 
-        for(auto& [stockLocate, stockOrders] : orders){
+        for(auto& [stockLocate, stockTrades] : tradeTape){
             name = stockMap[stockLocate];
-            for(auto& [orderRefNumber, order] : stockOrders){
-                openOrders << name << ",";
-                for(auto& orderEl : order){
-                    std::visit([&openOrders](auto&& value) {
-                        openOrders << value << ",";  // Write each value followed by a comma
-                    }, orderEl);
-                }
-                openOrders << "\n";
+            for(const TapeTrade& trade : stockTrades){
+                rawTrades << name << "," << trade.timestamp << "," << trade.shares << "," << trade.price / 10000.0 << ",\n";
+            }
+        }
 
-                //rawTrades << name << "," << (trade)[0] << "," << (trade)[1] << "," << (trade)[3] << ",\n";
+        for(auto& [stockLocate, stockOrders] : orders){
+            name = stockMap[stockLocate];
+            for(auto& [orderRefNumber, order] : stockOrders.sorted()){
+                openOrders << name << "," << order.timestamp << "," << order.shares << "," << order.price << ",\n";
             }
         }
         orders.clear();
+        orderTables.clear();
     }
 
     void writeVWAP(){
+        if(profiler){
+            profiler->switchTo(ProfileStage::Output);
+        }
+        if(vwapConsumer){
+            VWAPRecord record{};
+            for(auto& [stockLocate, hourlyVWAP]: vwapMap){
+                copySymbol(record.name, stockMap[stockLocate]);
+                for(auto& [hour, vwap]: hourlyVWAP){
+                    record.hour = hour;
+                    record.vwap = vwap;
+                    vwapConsumer(record);
+                }
+            }
+            return;
+        }
+
+        if(vwapSink){
+            VWAPRecord record{};
+            for(auto& [stockLocate, hourlyVWAP]: vwapMap){
+                copySymbol(record.name, stockMap[stockLocate]);
+                for(auto& [hour, vwap]: hourlyVWAP){
+                    record.hour = hour;
+                    record.vwap = vwap;
+                    vwapSink->push(record);
+                }
+            }
+            return;
+        }
+
+        if(pool){
+            writeVWAPParallel();
+            return;
+        }
+
         std::ofstream finVWAP;
         std::string name;
         finVWAP.open(finalVWAPFilePath);
@@ -100,236 +269,906 @@ class Parser{
         }
     }
 
+    static std::pair<double, uint64_t> fetchPV(const TapeTrade& trade){
+        return {trade.shares * (trade.price / 10000.0), trade.shares};
+    }
+
+    bool hasTrade(uint16_t stockLocate, uint64_t matchNumber){
+        if(compactTrades){
+            return tradeTape.contains(stockLocate, matchNumber);
+        }
+        return trades[stockLocate].find(matchNumber) != trades[stockLocate].end();
+    }
+
+    template<typename Shares>
+    void storeTrade(uint16_t stockLocate, uint64_t matchNumber, uint64_t timestamp, Shares shares, double price){
+        AllocationScope scope(AllocationHandler::Trades);
+        if(compactTrades){
+            TapeTrade trade{timestamp, shares, uint32_t(std::llround(price * 10000.0)), matchNumber};
+            tradeTape.append(stockLocate, trade);
+            onTrade(stockLocate, timestamp, fetchPV(trade));
+        }
+        else{
+            DataRow& trade = trades[stockLocate][matchNumber];
+            trade = {timestamp, shares, price};
+            onTrade(stockLocate, timestamp, fetchPV(trade));
+        }
+    }
+
+    void breakTrade(uint16_t stockLocate, uint64_t matchNumber){
+        AllocationScope scope(AllocationHandler::Trades);
+        if(compactTrades){
+            TapeTrade removed;
+            if(tradeTape.remove(stockLocate, matchNumber, &removed)){
+                onBrokenTrade(stockLocate, fetchPV(removed));
+            }
+            return;
+        }
+        auto& stockTrades = trades[stockLocate];
+        auto it = stockTrades.find(matchNumber);
+        if(it == stockTrades.end()){
+            // std::cerr << "[BrokenTrade] Match Number " << matchNumber << " not found!" << std::endl;
+            return;
+        }
+        onBrokenTrade(stockLocate, fetchPV(it->second));
+        stockTrades.erase(it);
+    }
+
+    // Appends the cumulative VWAP of every symbol that traded in hour and flushes it straight away.
+    void closeHour(uint16_t hour){
+        AllocationScope scope(AllocationHandler::Incremental);
+        std::sort(activeSymbols.begin(), activeSymbols.end());
+        VWAPRecord record{};
+        record.hour = hour;
+        for(uint16_t stockLocate : activeSymbols){
+            RunningVWAP& running = runningVWAP[stockLocate];
+            double vwap = running.volume == 0 ? 0.0 : running.pv / double(running.volume);
+            auto it = stockMap.find(stockLocate);
+            std::string_view name = it == stockMap.end() ? std::string_view() : std::string_view(it->second);
+            if(incrementalSink){
+                copySymbol(record.name, name);
+                record.vwap = vwap;
+                incrementalSink->push(record);
+            }
+            else{
+                incrementalVWAP << name << "," << hour << "," << vwap << ",\n";
+            }
+        }
+        activeSymbols.clear();
+        if(!incrementalSink){
+            incrementalVWAP.flush();
+        }
+    }
+
+    // Closes every hour that ended before ts.
+    void advanceClock(uint64_t ts){
+        uint16_t hour = ceilDiv(ts, nanosecondsPerHour);
+        if(hour > currentHour){
+            if(currentHour != 0){
+                closeHour(currentHour);
+            }
+            currentHour = hour;
+        }
+    }
+
+    void onTrade(uint16_t stockLocate, uint64_t ts, std::pair<double, uint64_t> tradePVInfo){
+        if(live){
+            live->onTrade(stockLocate, ts, tradePVInfo.first, tradePVInfo.second);
+        }
+        if(!incremental){
+            return;
+        }
+        auto [tradePV, volume] = tradePVInfo;
+        RunningVWAP& running = runningVWAP[stockLocate];
+        running.pv += tradePV;
+        running.volume += volume;
+        if(running.activeHour != currentHour){
+            running.activeHour = currentHour;
+            activeSymbols.push_back(stockLocate);
+        }
+    }
+
+    // A broken trade leaves the already emitted hours untouched and corrects the running totals from here on.
+    void onBrokenTrade(uint16_t stockLocate, std::pair<double, uint64_t> tradePVInfo){
+        if(live){
+            live->onBrokenTrade(stockLocate, tradePVInfo.first, tradePVInfo.second);
+        }
+        if(!incremental){
+            return;
+        }
+        auto [tradePV, volume] = tradePVInfo;
+        RunningVWAP& running = runningVWAP[stockLocate];
+        running.pv -= tradePV;
+        running.volume -= std::min(volume, running.volume);
+    }
+
+    // Catch-up mode conflates the BBO tape and holds back live snapshots; leaving it restores both.
+    void onCatchUpChanged(){
+        if(bbo && catchUp->active()){
+            bboConflationMicros = bbo->conflationMicros();
+            bbo->setConflation(std::max(bboConflationMicros, catchUp->bboConflationMicros()));
+        }
+        else if(bbo){
+            bbo->setConflation(bboConflationMicros);
+        }
+        if(live){
+            live->holdPublishing(catchUp->active());
+        }
+    }
+
+    // 'S' end of system hours / end of messages close the last hour.
+    void onSkippedMessage(const Event& msg){
+        if(!incremental){
+            return;
+        }
+        if(msg.type == 'S' && (msg.indicator == 'E' || msg.indicator == 'C') && currentHour != 0){
+            closeHour(currentHour);
+        }
+    }
+
+    OrderTable& ordersOf(uint16_t stockLocate){
+        if(orderTables.empty()){
+            orderTables.assign(size_t(UINT16_MAX) + 1, nullptr);
+        }
+        OrderTable*& table = orderTables[stockLocate];
+        if(!table){
+            table = &orders[stockLocate];
+        }
+        return *table;
+    }
+
+    // Pulls the order table slot msg is going to look up or fill into cache. Read only, applying stays in order.
+    void prefetch(const Event& msg){
+        switch(msg.type){
+            case 'A':
+            case 'F':
+            case 'E':
+            case 'C':
+            case 'X':
+            case 'D':
+            case 'U':
+                if(!orderTables.empty() && orderTables[msg.stockLocate]){
+                    orderTables[msg.stockLocate]->prefetch(msg.orderRefNumber);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Lookahead mode: msg joins the window and its lookup is prefetched, the oldest Event of a full
+    // window is applied. The misses of the window's lookups overlap instead of stalling one by one.
+    // Returns the window slot for the next message, after applying the Event it held.
+    Event& nextWindowSlot(){
+        Event& slot = window[windowCount++ & (window.size() - 1)];
+        if(windowCount > window.size()){
+            apply(slot);
+        }
+        return slot;
+    }
+
+    void applyAhead(const Event& msg){
+        Event& slot = nextWindowSlot();
+        slot = msg;
+        prefetch(slot);
+    }
+
+    void drainAhead(){
+        size_t pending = std::min(windowCount, window.size());
+        for(size_t i = windowCount - pending; i < windowCount; i++){
+            apply(window[i & (window.size() - 1)]);
+        }
+        windowCount = 0;
+    }
+
+    // End of input: closes the last incremental hour and finishes every attached consumer.
+    void finishParse(){
+        if(incremental && !activeSymbols.empty()){
+            closeHour(currentHour);
+        }
+        if(incrementalSink){
+            incrementalSink->close();
+        }
+        if(bbo){
+            bbo->finish();
+        }
+        if(snapshots){
+            snapshots->finish();
+        }
+        if(live){
+            live->publish();
+        }
+    }
+
+    // Formats every symbol's rows as its own task, then writes the blocks in symbol order.
+    void writeVWAPParallel(){
+        std::vector<std::pair<uint16_t, const std::pmr::map<uint16_t, double>*>> symbols;
+        for(auto& [stockLocate, hourlyVWAP]: vwapMap){
+            symbols.push_back({stockLocate, &hourlyVWAP});
+        }
+        std::vector<std::string> blocks(symbols.size());
+        for(size_t i = 0; i < symbols.size(); i++){
+            pool->submit([this, &symbols, &blocks, i](){
+                auto it = stockMap.find(symbols[i].first);
+                std::string_view name = it == stockMap.end() ? std::string_view() : std::string_view(it->second);
+                std::ostringstream block;
+                for(auto& [hour, vwap]: *symbols[i].second){
+                    block << name << "," << hour << "," << vwap << ",\n";
+                }
+                blocks[i] = block.str();
+            });
+        }
+        pool->wait();
+
+        std::ofstream finVWAP;
+        finVWAP.open(finalVWAPFilePath);
+        finVWAP << "name,hour,vwap,\n";
+        for(auto& block : blocks){
+            finVWAP << block;
+        }
+    }
+
+    template<typename F>
+    static void visitTrades(const std::pmr::map<uint64_t, DataRow>& execTrades, F fn){
+        for(auto& [matchNumber, trade] : execTrades){
+            fn(std::get<uint64_t>(trade[0]), fetchPV(trade));
+        }
+    }
+
+    template<typename F>
+    static void visitTrades(const SymbolTape& execTrades, F fn){
+        for(const TapeTrade& trade : execTrades){
+            fn(trade.timestamp, fetchPV(trade));
+        }
+    }
+
+    // (hour, cumulative PV, cumulative volume) at the end of every hour with trades, summed in the
+    // same order as processRunningVWAP() so the VWAP derived from them is identical.
+    template<typename SymbolTrades>
+    std::vector<std::tuple<uint16_t, double, uint64_t>> hourlyTotalsOf(const SymbolTrades& execTrades) const {
+        std::map<uint16_t, std::vector<std::pair<double, uint64_t>>> hourlyPVInfo;
+        visitTrades(execTrades, [this, &hourlyPVInfo](uint64_t ts, std::pair<double, uint64_t> pvInfo){
+            hourlyPVInfo[ceilDiv(ts, nanosecondsPerHour)].push_back(pvInfo);
+        });
+
+        std::vector<std::tuple<uint16_t, double, uint64_t>> hourlyTotals;
+        double currPV = 0.0;
+        uint64_t totalTradedQuantity = 0;
+        for(auto& [hour, pvInfoList] : hourlyPVInfo){
+            for(auto& pvInfo : pvInfoList){
+                currPV += pvInfo.first;
+                totalTradedQuantity += pvInfo.second;
+            }
+            hourlyTotals.push_back({hour, currPV, totalTradedQuantity});
+        }
+        return hourlyTotals;
+    }
+
+    // Cumulative VWAP at the end of every hour with trades.
+    template<typename SymbolTrades>
+    std::vector<std::pair<uint16_t, double>> hourlyVWAPOf(const SymbolTrades& execTrades){
+        std::vector<std::pair<uint16_t, double>> hourlyVWAP;
+        for(auto& [hour, currPV, totalTradedQuantity] : hourlyTotalsOf(execTrades)){
+            hourlyVWAP.push_back({hour, totalTradedQuantity == 0 ? 0.0 : currPV / double(totalTradedQuantity)});
+        }
+        return hourlyVWAP;
+    }
+
+    // One task per symbol on the work-stealing pool. The tasks only use heap memory local to the task
+    // (the Parser's resource need not be thread safe); vwapMap is assembled afterwards in symbol order.
+    template<typename TradeStore>
+    void processRunningVWAPParallel(const TradeStore& tradeStore){
+        using SymbolTrades = std::decay_t<decltype(tradeStore.begin()->second)>;
+        std::vector<std::pair<uint16_t, const SymbolTrades*>> symbols;
+        for(auto& [stockLocate, execTrades] : tradeStore){
+            if(execTrades.size()){
+                symbols.push_back({stockLocate, &execTrades});
+            }
+        }
+        std::vector<std::vector<std::pair<uint16_t, double>>> results(symbols.size());
+
+        // Workers run their own deque newest first, so submitting the quietest symbols first
+        // makes every worker start on the most active symbols.
+        std::vector<size_t> submitOrder(symbols.size());
+        std::iota(submitOrder.begin(), submitOrder.end(), 0);
+        std::stable_sort(submitOrder.begin(), submitOrder.end(), [&symbols](size_t a, size_t b){
+            return symbols[a].second->size() < symbols[b].second->size();
+        });
+        for(size_t i : submitOrder){
+            pool->submit([this, &symbols, &results, i](){
+                results[i] = hourlyVWAPOf(*symbols[i].second);
+            });
+        }
+        pool->wait();
+
+        for(size_t i = 0; i < symbols.size(); i++){
+            auto& hourlyVWAP = vwapMap[symbols[i].first];
+            for(auto& [hour, vwap] : results[i]){
+                hourlyVWAP[hour] = vwap;
+            }
+        }
+
+        writeVWAP();
+    }
+
+    // Replaces the containers with empty ones without running their destructors. Only valid when
+    // the memory is owned by a ParserArena, which gets all of it back in a single release().
+    void abandonState(){
+        new (&stockMap) SymbolTable(resource);
+        new (&orders) OrderBook(resource);
+        orderTables.clear();
+        new (&trades) DataBook(resource);
+        new (&pv) HourlyPV(resource);
+        new (&vwapMap) HourlyVWAP(resource);
+        new (&tradeTape) TradeTape(resource);
+    }
+
     public:
-    Parser(std::string fp) : fp(fp) {
-        stockMap.clear();
-        orders.clear();
-        trades.clear();
-    };
+    Parser(std::string fp, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : fp(fp), resource(resource), arena(dynamic_cast<ParserArena*>(resource)),
+          stockMap(resource), orders(resource), trades(resource), pv(resource), vwapMap(resource), tradeTape(resource) {};
 
-    void parse(){
-        std::ifstream binFile(fp, std::ios::binary);
+    Parser(std::string fp, std::string finalVWAPFilePath, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : fp(fp), finalVWAPFilePath(finalVWAPFilePath), resource(resource), arena(dynamic_cast<ParserArena*>(resource)),
+          stockMap(resource), orders(resource), trades(resource), pv(resource), vwapMap(resource), tradeTape(resource) {};
 
-        if(!binFile){
-            std::cerr << "Error loading the binary file" << std::endl;
+    ~Parser(){
+        if(arena){
+            abandonState();
         }
-        char messageType;
-        std::vector<Data> order, newOrder, trade;
-
-        while(binFile.read(&messageType, 1)) {
-            auto it = packet_sizes.find(messageType);
-            if (it != packet_sizes.end()){
-                // if (messageType == 'S') {
-                //     SystemEvent msg;
-                //     msg.load(binFile);
-                // } 
-                if (messageType == 'R') {
-                    StockDirectory msg;
-                    msg.load(binFile);
-                    stockMap[msg.stockLocate] = msg.stock;
-                }
-                // else if (messageType == 'H') {
-                //     StockTradingAction msg;
-                //     msg.load(binFile);
-                // }
-                // else if (messageType == 'Y') {
-                //     RegSHOShortSalePriceTestIndicator msg;
-                //     msg.load(binFile);
-                // } 
-                // else if (messageType == 'L') {
-                //     MarketParticipationPos msg;
-                //     msg.load(binFile);
-                // }
-                // else if (messageType == 'V') {
-                //     MWCBDecline msg;
-                //     msg.load(binFile);
-                // } 
-                // else if (messageType == 'W') {
-                //     MWCBStatus msg;
-                //     msg.load(binFile);
-                // } 
-                // else if (messageType == 'K') {
-                //     QuotingPeriodUpdate msg;
-                //     msg.load(binFile);
-                // } 
-                // else if (messageType == 'J') {
-                //     LULDAuctionCollar msg;
-                //     msg.load(binFile);
-                // } 
-                // else if (messageType == 'h') {
-                //     OpeartionalHalt msg;
-                //     msg.load(binFile);
-                // } 
-                else if (messageType == 'A') {
-                    AddOrderNoMPID msg;
-                    msg.load(binFile);
-                    if(msg.buySellIndicator == 'B'){
-
-                        // If Order not found earlier
-                        if(orders[msg.stockLocate].find(msg.orderRefNumber) == orders[msg.stockLocate].end()){
-                            order = {msg.timestamp, msg.shares, msg.price};
-                            orders[msg.stockLocate][msg.orderRefNumber] = order;
-                        }
-                        else {
-                            std::cerr << "[AddOrderNoMPID] Order Ref " << msg.orderRefNumber << " was already in queue" << std::endl;
-                        }
-                    }
-                } 
-                else if (messageType == 'F') {
-                    AddOrderWithMPID msg;
-                    msg.load(binFile);
+    }
 
-                    if(msg.buySellIndicator == 'B'){
+    // Starts over on another file with empty state. On a ParserArena the old state is dropped in one shot.
+    void reset(std::string nextFp){
+        fp = nextFp;
+        if(arena){
+            abandonState();
+            arena->release();
+        }
+        else{
+            stockMap.clear();
+            orders.clear();
+            orderTables.clear();
+            trades.clear();
+            pv.clear();
+            vwapMap.clear();
+            tradeTape = TradeTape(resource);
+        }
+    }
 
-                        // If Order not found earlier
-                        if(orders[msg.stockLocate].find(msg.orderRefNumber) != orders[msg.stockLocate].end()){
-                            std::cerr << "[AddOrderWithMPID] Order Ref " << msg.orderRefNumber << " already exists!" << std::endl;
-                        }
-                        else {
-                            order = {msg.timestamp, msg.shares, msg.price};
-                            orders[msg.stockLocate][msg.orderRefNumber] = order;
-                        }
-                    }
-                } 
-                else if (messageType == 'E') {
-                    OrderExecuted msg;
-                    msg.load(binFile);
-                    if(orders[msg.stockLocate].find(msg.orderRefNumber) == orders[msg.stockLocate].end()){
-                        // std::cerr << "[OrderExecuted] Order Ref " << msg.orderRefNumber << " not found!" << std::endl;
-                    }
-                    else {
-                        order = orders[msg.stockLocate][msg.orderRefNumber];
-                        uint32_t dVol = std::get<uint32_t>(order[1]) - msg.executedShares;
-                        if(dVol >= 0){
-                            trades[msg.stockLocate][msg.matchNumber] = {msg.timestamp, msg.executedShares, std::get<double>(order[2])};
-                            if(dVol > 0){
-                                order[1] = dVol;
-                                orders[msg.stockLocate][msg.orderRefNumber] = order;
-                            }
-                            else{
-                                orders[msg.stockLocate].erase(msg.orderRefNumber);
-                            }
-                        }
-                    }
-                } 
-                else if (messageType == 'C') {
-                    OrderExecutedWithPrice msg;
-                    msg.load(binFile);
-                    if(orders[msg.stockLocate].find(msg.orderRefNumber) == orders[msg.stockLocate].end()){
-                        // std::cerr << "[OrderExecutedWithPrice] Order Ref " << msg.orderRefNumber << " not found!" << std::endl;
-                    }
-                    else {
-                        order = orders[msg.stockLocate][msg.orderRefNumber];
-                        uint32_t dVol = std::get<uint32_t>(order[1]) - msg.executedShares;
-                        if(dVol >= 0){
-                            if(msg.printable == 'Y'){
-                                trades[msg.stockLocate][msg.matchNumber] = {msg.timestamp, msg.executedShares, msg.executionPrice};
-                            }
-                            if(dVol > 0){
-                                order[1] = dVol;
-                                orders[msg.stockLocate][msg.orderRefNumber] = order;
-                            }
-                            else{
-                                orders[msg.stockLocate].erase(msg.orderRefNumber);
-                            }
-                        }
-                    }
+    // Appends every hour's cumulative VWAP of the symbols that traded in it to filePath as soon as
+    // the hour is over, instead of waiting for the end of the file. Hour boundaries come from the
+    // message timestamps; broken trades only correct the hours that are still open.
+    void enableIncrementalOutput(std::string filePath){
+        incremental = true;
+        runningVWAP.assign(size_t(UINT16_MAX) + 1, RunningVWAP());
+        if(asyncOutput){
+            incrementalSink = std::make_unique<AsyncWriter<VWAPRecord>>(asyncOutputPath(filePath), asyncFormat, asyncPolicy);
+            return;
+        }
+        incrementalVWAP.open(filePath);
+        if(!incrementalVWAP){
+            std::cerr << "Error opening the incremental VWAP file " << filePath << std::endl;
+        }
+        incrementalVWAP << "name,hour,vwap,\n";
+        incrementalVWAP.flush();
+    }
 
-                } 
-                else if (messageType == 'X') {
-                    OrderCancel msg;
-                    msg.load(binFile);
-                    if(orders[msg.stockLocate].find(msg.orderRefNumber) == orders[msg.stockLocate].end()){
-                        // std::cerr << "[OrderCancel] Order Ref " << msg.orderRefNumber << " not found!" << std::endl;
-                    }
-                    else {
-                        order = orders[msg.stockLocate][msg.orderRefNumber];
-                        uint32_t dVol = std::get<uint32_t>(order[1]) - msg.cancelledShares;
-                        if(dVol >= 0){
-                            if(dVol > 0){
-                                order[1] = dVol;
-                                orders[msg.stockLocate][msg.orderRefNumber] = order;
-                            }
-                            else{
-                                orders[msg.stockLocate].erase(msg.orderRefNumber);
-                            }
-                        }
-                    } 
+    // Keeps trades in the delta/varint encoded TradeTape (a few bytes per trade) instead of the
+    // trades map. Must be called before parse().
+    void enableCompactTrades(){
+        compactTrades = true;
+    }
+
+    bool hasCompactTrades() const {
+        return compactTrades;
+    }
+
+    const TradeTape& getTradeTape() const {
+        return tradeTape;
+    }
+
+    // Runs processRunningVWAP() and writeVWAP() as per-symbol tasks on the pool.
+    void setWorkerPool(WorkStealingPool* workerPool){
+        pool = workerPool;
+    }
+
+    // Hands all result writing to background writer threads, the engine only pushes fixed size records.
+    // Binary output replaces the .csv extension of every output path with .bin.
+    void enableAsyncOutput(OutputFormat format, BackpressurePolicy policy){
+        asyncOutput = true;
+        asyncFormat = format;
+        asyncPolicy = policy;
+        vwapSink = std::make_unique<AsyncWriter<VWAPRecord>>(asyncOutputPath(finalVWAPFilePath), format, policy);
+    }
+
+    // Drains and closes the asynchronous sinks, also done on destruction.
+    void closeOutput(){
+        vwapSink.reset();
+        rawTradesSink.reset();
+        openOrdersSink.reset();
+    }
+
+    // Keeps the next depth decoded messages in a window and prefetches their order lookups before
+    // applying them in the original order (group prefetching), so the cache misses of a large order
+    // book overlap. Used by parse(), the latency oriented follow() applies every message at once.
+    // depth is rounded up to a power of two.
+    void enableLookahead(size_t depth){
+        size_t size = 1;
+        while(size < depth){
+            size *= 2;
+        }
+        window.assign(size, Event());
+        windowCount = 0;
+    }
+
+    // Restricts the engine to the symbols whose stock locate is in [first, last], for one shard of a
+    // multi-process run (see shard.hpp). Messages without a locate, like System Events, always apply.
+    void setLocateRange(uint16_t first, uint16_t last){
+        firstLocate = first;
+        lastLocate = last;
+    }
+
+    // writeVWAP() hands every row to consumer instead of writing the VWAP file.
+    void setVWAPConsumer(std::function<void(const VWAPRecord&)> consumer){
+        vwapConsumer = consumer;
+    }
+
+    // Decodes on a separate thread that hands batches of Events to the parsing thread, so decoding
+    // and applying run on two cores.
+    void enablePipelinedDecode(){
+        pipelined = true;
+    }
+
+    // Feeds every order level message into tracker, which emits the conflated quote tape during parse().
+    void setBBOTracker(BBOTracker* tracker){
+        bbo = tracker;
+    }
+
+    // Writes periodic per-symbol book snapshots and the offsets of the messages between them during parse(),
+    // for as-of book queries with BookHistory.
+    void setBookSnapshots(BookSnapshotWriter* writer){
+        snapshots = writer;
+    }
+
+    // Publishes running per-symbol VWAP and volume to live during parse(), for concurrent readers.
+    void setLiveVWAP(LiveVWAP* publisher){
+        live = publisher;
+    }
+
+    // Lets follow() switch into catch-up mode when it falls behind the file, see CatchUpMonitor.
+    void setCatchUpMonitor(CatchUpMonitor* monitor){
+        catchUp = monitor;
+    }
+
+    // Pushes every trade and every order still open into the export sorters, which sort by symbol and
+    // time on disk once they exceed their memory budget. Several Parsers can share the sorters.
+    void exportRawInfo(RawExportSorter& tradeExport, RawExportSorter& orderExport, uint32_t day){
+        constexpr size_t chunkSize = 4096;
+        std::vector<RawExportRecord> chunk;
+        chunk.reserve(chunkSize);
+        auto add = [&chunk](RawExportSorter& sorter, const RawExportRecord& record){
+            chunk.push_back(record);
+            if(chunk.size() == chunkSize){
+                sorter.push(chunk.data(), chunk.size());
+                chunk.clear();
+            }
+        };
+        RawExportRecord record{};
+        record.day = day;
+        for(auto& [stockLocate, stockTrades] : trades){
+            copySymbol(record.name, stockMap[stockLocate]);
+            for(auto& [matchNumber, trade] : stockTrades){
+                record.timestamp = toUInt(trade[0]);
+                record.volume = toUInt(trade[1]);
+                record.price = std::get<double>(trade[2]);
+                add(tradeExport, record);
+            }
+        }
+        for(auto& [stockLocate, stockTrades] : tradeTape){
+            copySymbol(record.name, stockMap[stockLocate]);
+            for(const TapeTrade& trade : stockTrades){
+                record.timestamp = trade.timestamp;
+                record.volume = trade.shares;
+                record.price = trade.price / 10000.0;
+                add(tradeExport, record);
+            }
+        }
+        tradeExport.push(chunk.data(), chunk.size());
+        chunk.clear();
+        for(auto& [stockLocate, stockOrders] : orders){
+            copySymbol(record.name, stockMap[stockLocate]);
+            for(auto& [orderRefNumber, order] : stockOrders.sorted()){
+                record.timestamp = order.timestamp;
+                record.volume = order.shares;
+                record.price = order.price;
+                add(orderExport, record);
+            }
+        }
+        orderExport.push(chunk.data(), chunk.size());
+    }
+
+    // Everything besides the input file that changes the results, for ResultCache keys.
+    std::string resultConfiguration() const {
+        return "vwap/1 hour=" + std::to_string(nanosecondsPerHour) + " locates=" + std::to_string(firstLocate) + "-" + std::to_string(lastLocate);
+    }
+
+    // The aggregate stage of the hourly VWAP: cumulative PV and volume per symbol and hour. Call after parse().
+    std::vector<HourlyAggregate> hourlyAggregates() const {
+        std::vector<HourlyAggregate> aggregates;
+        auto collect = [this, &aggregates](const auto& tradeStore){
+            for(auto& [stockLocate, execTrades] : tradeStore){
+                auto it = stockMap.find(stockLocate);
+                HourlyAggregate aggregate{};
+                copySymbol(aggregate.name, it == stockMap.end() ? std::string_view() : std::string_view(it->second));
+                aggregate.stockLocate = stockLocate;
+                for(auto& [hour, currPV, totalTradedQuantity] : hourlyTotalsOf(execTrades)){
+                    aggregate.hour = hour;
+                    aggregate.cumulativePV = currPV;
+                    aggregate.cumulativeVolume = totalTradedQuantity;
+                    aggregates.push_back(aggregate);
                 }
-                else if (messageType == 'D') {
-                    OrderDelete msg;
-                    msg.load(binFile);
-                    if(orders[msg.stockLocate].find(msg.orderRefNumber) == orders[msg.stockLocate].end()){
-                        // std::cerr << "[OrderDelete] Order Ref " << msg.orderRefNumber << " not found!" << std::endl;
-                    }
-                    else{
-                        orders[msg.stockLocate].erase(msg.orderRefNumber);
-                    }
-                } 
-                else if (messageType == 'U') {
-                    OrderReplace msg;
-                    msg.load(binFile);
-                    if(orders[msg.stockLocate].find(msg.originalOrderRefNumber) == orders[msg.stockLocate].end()){
-                        // std::cerr << "[OrderReplace] Order Ref " << msg.originalOrderRefNumber << " not found!" << std::endl;
-                    }
-                    else{
-                        orders[msg.stockLocate].erase(msg.originalOrderRefNumber);
-                        newOrder = {msg.timestamp, msg.shares, msg.price};
-                        orders[msg.stockLocate][msg.newOrderRefNumber] = newOrder;
-                    }
-                } 
-                else if (messageType == 'P') {
-                    NonCrossTrade msg;
-                    msg.load(binFile);
-                    if(trades[msg.stockLocate].find(msg.matchNumber) != trades[msg.stockLocate].end()){
-                        std::cerr << "[NonCrossTrade] Match Number " << msg.matchNumber << " already exists!" << std::endl;
-                    }
-                    else if(msg.buySellIndicator == 'B'){
-                        trade = {msg.timestamp, msg.shares, msg.price};
-                        trades[msg.stockLocate][msg.matchNumber] = trade;
-                    }
-                } 
-                else if (messageType == 'Q') {
-                    CrossTrade msg;
-                    msg.load(binFile);
-                    if(trades[msg.stockLocate].find(msg.matchNumber) != trades[msg.stockLocate].end()){
-                        std::cerr << "[CrossTrade] Match Number " << msg.matchNumber << " already exists!" << std::endl;
-                    }
-                    else {
-                        trade = {msg.timestamp, msg.shares, msg.crossPrice};
-                        trades[msg.stockLocate][msg.matchNumber] = trade;
-                    }
+            }
+        };
+        collect(tradeTape);
+        collect(trades);
+        std::stable_sort(aggregates.begin(), aggregates.end(), [](const HourlyAggregate& a, const HourlyAggregate& b){
+            return a.stockLocate < b.stockLocate;
+        });
+        return aggregates;
+    }
+
+    // Instead of parse() and processRunningVWAP(): rebuilds the hourly VWAP from cached aggregates and writes it.
+    void loadAggregates(const std::vector<HourlyAggregate>& aggregates){
+        for(const HourlyAggregate& aggregate : aggregates){
+            stockMap[aggregate.stockLocate] = symbolString(aggregate.name);
+            vwapMap[aggregate.stockLocate][aggregate.hour] = aggregate.cumulativeVolume == 0 ? 0.0 : aggregate.cumulativePV / double(aggregate.cumulativeVolume);
+        }
+        writeVWAP();
+    }
+
+    // Runs parse() and processRunningVWAP() with per stage hardware counters, see parseProfiled().
+    void setStageProfiler(StageProfiler* stageProfiler){
+        profiler = stageProfiler;
+    }
+
+    const SymbolTable& getStockMap() const {
+        return stockMap;
+    }
+
+    const DataBook& getTrades() const {
+        return trades;
+    }
+
+    const HourlyVWAP& getVWAP() const {
+        return vwapMap;
+    }
 
-                } 
-                else if (messageType == 'B') {
-                    BrokenTrade msg;
-                    msg.load(binFile);
-                    if(trades[msg.stockLocate].find(msg.matchNumber) == trades[msg.stockLocate].end()){
-                        // std::cerr << "[BrokenTrade] Match Number " << msg.matchNumber << " not found!" << std::endl;
+    // Applies one decoded message to the order book, the trades and every attached consumer.
+    void apply(const Event& msg){
+        AllocationScope scope(msg.type, AllocationHandler::Apply);
+        // Every message moves the clock, so an hour is written as soon as the feed passes its end.
+        if(incremental){
+            advanceClock(msg.timestamp);
+        }
+        if(msg.stockLocate && (msg.stockLocate < firstLocate || msg.stockLocate > lastLocate)){
+            onSkippedMessage(msg);
+            return;
+        }
+        if(snapshots){
+            AllocationScope snapshotScope(AllocationHandler::Snapshots);
+            snapshots->onEvent(msg);
+        }
+        switch(msg.type){
+            case 'R':
+                stockMap[msg.stockLocate] = rstrip(std::string(msg.stock, sizeof(msg.stock)));
+                if(live){
+                    live->onSymbol(msg.stockLocate, msg.stock);
+                }
+                break;
+            case 'A':
+            case 'F': {
+                if(bbo){
+                    AllocationScope bboScope(AllocationHandler::BBO);
+                    bbo->onAdd(msg.timestamp, msg.stockLocate, msg.orderRefNumber, msg.side, uint32_t(msg.shares), msg.price);
+                }
+                if(msg.side == 'B'){
+                    // Only orders not found earlier are added
+                    if(ordersOf(msg.stockLocate).insert(msg.orderRefNumber, {msg.timestamp, uint32_t(msg.shares), msg.price / 10000.0})){
+                        break;
+                    }
+                    if(msg.type == 'A'){
+                        std::cerr << "[AddOrderNoMPID] Order Ref " << msg.orderRefNumber << " was already in queue" << std::endl;
                     }
                     else{
-                        trades[msg.stockLocate].erase(msg.matchNumber);
+                        std::cerr << "[AddOrderWithMPID] Order Ref " << msg.orderRefNumber << " already exists!" << std::endl;
                     }
-                } 
-                // else if (messageType == 'I') {
-                //     NetOrderImbalance msg;
-                //     msg.load(binFile);
-                // }
+                }
+                break;
+            }
+            case 'E':
+            case 'C': {
+                if(bbo){
+                    AllocationScope bboScope(AllocationHandler::BBO);
+                    bbo->onExecute(msg.timestamp, msg.orderRefNumber, uint32_t(msg.shares));
+                }
+                auto& stockOrders = ordersOf(msg.stockLocate);
+                RestingOrder* order = stockOrders.find(msg.orderRefNumber);
+                if(!order){
+                    // std::cerr << "[OrderExecuted] Order Ref " << msg.orderRefNumber << " not found!" << std::endl;
+                    break;
+                }
+                uint32_t dVol = order->shares - uint32_t(msg.shares);
+                if(msg.type == 'E'){
+                    storeTrade(msg.stockLocate, msg.matchNumber, msg.timestamp, uint32_t(msg.shares), order->price);
+                }
+                else if(msg.indicator == 'Y'){
+                    storeTrade(msg.stockLocate, msg.matchNumber, msg.timestamp, uint32_t(msg.shares), msg.price / 10000.0);
+                }
+                if(dVol > 0){
+                    order->shares = dVol;
+                }
+                else{
+                    stockOrders.erase(msg.orderRefNumber);
+                }
+                break;
+            }
+            case 'X': {
+                if(bbo){
+                    AllocationScope bboScope(AllocationHandler::BBO);
+                    bbo->onCancel(msg.timestamp, msg.orderRefNumber, uint32_t(msg.shares));
+                }
+                auto& stockOrders = ordersOf(msg.stockLocate);
+                RestingOrder* order = stockOrders.find(msg.orderRefNumber);
+                if(!order){
+                    // std::cerr << "[OrderCancel] Order Ref " << msg.orderRefNumber << " not found!" << std::endl;
+                    break;
+                }
+                uint32_t dVol = order->shares - uint32_t(msg.shares);
+                if(dVol > 0){
+                    order->shares = dVol;
+                }
+                else{
+                    stockOrders.erase(msg.orderRefNumber);
+                }
+                break;
+            }
+            case 'D':
+                if(bbo){
+                    AllocationScope bboScope(AllocationHandler::BBO);
+                    bbo->onDelete(msg.timestamp, msg.orderRefNumber);
+                }
+                ordersOf(msg.stockLocate).erase(msg.orderRefNumber);
+                break;
+            case 'U': {
+                if(bbo){
+                    AllocationScope bboScope(AllocationHandler::BBO);
+                    bbo->onReplace(msg.timestamp, msg.orderRefNumber, msg.newOrderRefNumber, uint32_t(msg.shares), msg.price);
+                }
+                auto& stockOrders = ordersOf(msg.stockLocate);
+                if(!stockOrders.erase(msg.orderRefNumber)){
+                    // std::cerr << "[OrderReplace] Order Ref " << msg.orderRefNumber << " not found!" << std::endl;
+                    break;
+                }
+                stockOrders.insertOrAssign(msg.newOrderRefNumber, {msg.timestamp, uint32_t(msg.shares), msg.price / 10000.0});
+                break;
+            }
+            case 'P':
+                if(hasTrade(msg.stockLocate, msg.matchNumber)){
+                    std::cerr << "[NonCrossTrade] Match Number " << msg.matchNumber << " already exists!" << std::endl;
+                }
+                else if(msg.side == 'B'){
+                    storeTrade(msg.stockLocate, msg.matchNumber, msg.timestamp, uint32_t(msg.shares), msg.price / 10000.0);
+                }
+                break;
+            case 'Q':
+                if(hasTrade(msg.stockLocate, msg.matchNumber)){
+                    std::cerr << "[CrossTrade] Match Number " << msg.matchNumber << " already exists!" << std::endl;
+                }
                 else{
-                    char packet[it->second];
-                    binFile.read(packet, it->second);
-                    continue;
+                    storeTrade(msg.stockLocate, msg.matchNumber, msg.timestamp, msg.shares, msg.price / 10000.0);
                 }
+                break;
+            case 'B':
+                breakTrade(msg.stockLocate, msg.matchNumber);
+                break;
+            default:
+                onSkippedMessage(msg);
+                break;
+        }
+    }
+
+    void parse(){
+        if(profiler){
+            parseProfiled();
+            return;
+        }
+        if(pipelined && !window.empty()){
+            DecodePipeline pipeline(fp);
+            pipeline.run([this](const Event& msg){ applyAhead(msg); });
+            drainAhead();
+        }
+        else if(pipelined){
+            DecodePipeline pipeline(fp);
+            pipeline.run([this](const Event& msg){ apply(msg); });
+        }
+        else if(!window.empty()){
+            FrameReader reader(fp);
+            if(!reader.good()){
+                std::cerr << "Error loading the binary file" << std::endl;
+            }
+            size_t length;
+            while(const char* message = reader.next(length)){
+                Event& slot = nextWindowSlot();
+                decodeEvent(message, length, slot);
+                slot.offset = reader.messageOffset();
+                prefetch(slot);
+            }
+            drainAhead();
+        }
+        else{
+            FrameReader reader(fp);
+            if(!reader.good()){
+                std::cerr << "Error loading the binary file" << std::endl;
+            }
+            Event msg;
+            size_t length;
+            while(const char* message = reader.next(length)){
+                decodeEvent(message, length, msg);
+                msg.offset = reader.messageOffset();
+                apply(msg);
             }
         }
-        binFile.close();
+
+        finishParse();
 
         // Write Raw Data
         // writeRawInfo();
 
     }
 
+    // parse() under a StageProfiler: the mapped file is framed, decoded and applied in batches, so the
+    // counters are read at stage boundaries once per batch. Pipelined decode and lookahead do not apply.
+    void parseProfiled(){
+        constexpr size_t batchSize = 1024;
+        MappedFile file(fp);
+        if(!file.data()){
+            std::cerr << "Error loading the binary file" << std::endl;
+        }
+        const char* p = file.data();
+        const char* end = p + file.size();
+        std::vector<const char*> frames(batchSize);
+        std::vector<Event> events(batchSize);
+        while(true){
+            profiler->switchTo(ProfileStage::Framing);
+            size_t count = 0;
+            while(count < batchSize && end - p >= 2){
+                size_t length = size_t(loadBigEndian<2>(p));
+                if(length == 0 || size_t(end - p) - 2 < length){
+                    end = p;
+                    break;
+                }
+                frames[count++] = p;
+                p += 2 + length;
+            }
+            if(count == 0){
+                break;
+            }
+            profiler->switchTo(ProfileStage::Decode);
+            for(size_t i = 0; i < count; i++){
+                decodeEvent(frames[i] + 2, size_t(loadBigEndian<2>(frames[i])), events[i]);
+                events[i].offset = uint64_t(frames[i] - file.data());
+            }
+            profiler->switchTo(ProfileStage::Book);
+            for(size_t i = 0; i < count; i++){
+                apply(events[i]);
+            }
+            profiler->addMessages(count);
+        }
+        profiler->switchTo(ProfileStage::Output);
+        finishParse();
+    }
+
+    // parse() for a day file that is still being written. At the end of the file the state stays alive
+    // and only the newly appended complete messages are applied once the file grows (a partial message
+    // at the tail waits for its remaining bytes). Stops at the System Event end of messages, or after
+    // idleTimeoutMillis without growth (0 waits indefinitely).
+    void follow(uint64_t idleTimeoutMillis = 0){
+        FrameReader reader(fp);
+        if(!reader.good()){
+            std::cerr << "Error loading the binary file" << std::endl;
+        }
+        FileWatcher watcher(fp);
+        auto lastGrowth = std::chrono::steady_clock::now();
+        bool endOfMessages = false;
+        Event msg;
+        size_t length;
+        while(!endOfMessages){
+            while(const char* message = reader.next(length)){
+                if(catchUp){
+                    if(catchUp->due()){
+                        uint64_t position = reader.messageOffset() + 2 + length;
+                        uint64_t size = uint64_t(watcher.size());
+                        if(catchUp->check(size > position ? size - position : 0, msg.timestamp)){
+                            onCatchUpChanged();
+                        }
+                    }
+                    if(catchUp->skips(message[0])){
+                        catchUp->onSkipped();
+                        continue;
+                    }
+                }
+                decodeEvent(message, length, msg);
+                msg.offset = reader.messageOffset();
+                apply(msg);
+                if(msg.type == 'S' && msg.indicator == 'C'){
+                    endOfMessages = true;
+                    break;
+                }
+            }
+            if(endOfMessages){
+                break;
+            }
+            if(reader.emptyFrame()){
+                std::cerr << "[Parser] Empty message frame at offset " << reader.position() << ", stopping" << std::endl;
+                break;
+            }
+            if(watcher.waitForGrowth(100)){
+                lastGrowth = std::chrono::steady_clock::now();
+            }
+            else if(idleTimeoutMillis && std::chrono::steady_clock::now() - lastGrowth > std::chrono::milliseconds(idleTimeoutMillis)){
+                break;
+            }
+            reader.resume();
+        }
+        if(catchUp && catchUp->active() && catchUp->check(0, msg.timestamp)){
+            onCatchUpChanged();
+        }
+        finishParse();
+    }
+
+    // Consolidated run over several venues' feeds of the same day: FeedMerger decodes every feed on its
+    // own thread and merges them by timestamp, mapping each venue's locates onto common symbol ids.
+    // Book snapshots are not supported here, their offsets point into a single file. False, with nothing
+    // parsed, when FeedMerger rejects the feeds.
+    bool parseMerged(const std::vector<std::string>& feedPaths){
+        FeedMerger merger(feedPaths);
+        if(!merger.good()){
+            return false;
+        }
+        BookSnapshotWriter* snapshotWriter = snapshots;
+        if(snapshotWriter){
+            std::cerr << "[Parser] Book snapshots are ignored for merged feeds" << std::endl;
+            snapshots = nullptr;
+        }
+        merger.run([this](const Event& msg){ apply(msg); });
+        finishParse();
+        snapshots = snapshotWriter;
+        return true;
+    }
+
     void processRunningVWAP(){
+        if(profiler){
+            profiler->switchTo(ProfileStage::Aggregation);
+        }
+        if(pool && compactTrades){
+            processRunningVWAPParallel(tradeTape);
+            return;
+        }
+        if(pool){
+            processRunningVWAPParallel(trades);
+            return;
+        }
+
+        if(compactTrades){
+            for(auto& [stockLocate, execTrades] : tradeTape){
+                for(const TapeTrade& trade : execTrades){
+                    uint16_t hour = ceilDiv(trade.timestamp, nanosecondsPerHour);
+                    pv[stockLocate][hour].push_back(fetchPV(trade));
+                }
+            }
+        }
+
         for(auto& [stockLocate, execTrades] : trades){
             for(auto& [matchNumber, trade] : execTrades){
                 uint64_t ts = std::get<uint64_t>(trade[0]);
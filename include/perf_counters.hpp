@@ -0,0 +1,229 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+
+enum class ProfileStage{
+    Framing,
+    Decode,
+    Book,
+    Aggregation,
+    Output,
+    Count
+};
+
+inline const char* stageName(ProfileStage stage){
+    static constexpr const char* names[] = {"framing", "decode", "book", "aggregation", "output"};
+    return names[size_t(stage)];
+}
+
+// perf_event_attr.config of a PERF_TYPE_HW_CACHE read miss counter
+constexpr uint64_t cacheReadMiss(uint64_t cache){
+    return cache | (uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8) | (uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+}
+
+
+// Hardware counters of the calling thread, attributed to the pipeline stage that was running.
+// The Parser calls switchTo() at stage boundaries, once per batch of messages and not per message,
+// so the counter reads (one read() per group) stay a small fraction of the work measured.
+//
+// The counters form two groups of three, small enough to be scheduled together on any PMU, and are
+// scaled by their running time when the kernel multiplexes them. Counters that cannot be opened,
+// typically in containers or VMs without a virtual PMU or with perf_event_paranoid too high, are
+// reported as "-"; wall time per stage is always available.
+class StageProfiler{
+    static constexpr size_t stageCount = size_t(ProfileStage::Count);
+
+    struct CounterSpec{
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+        size_t group;
+    };
+
+    static constexpr CounterSpec specs[] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0},
+        {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 0},
+        {"l1d_misses", PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D), 1},
+        {"llc_misses", PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_LL), 1},
+        {"dtlb_misses", PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_DTLB), 1},
+    };
+    static constexpr size_t counterCount = sizeof(specs) / sizeof(specs[0]);
+    static constexpr size_t groupCount = 2;
+
+    struct Group{
+        int leader = -1;
+        // Index into specs of every opened member, in the group's read order
+        std::vector<size_t> members;
+    };
+
+    // Cumulative values, scaled for multiplexing
+    struct Reading{
+        double values[counterCount] = {};
+        std::chrono::steady_clock::time_point time;
+    };
+
+    Group groups[groupCount];
+    std::vector<int> fds;
+    bool available[counterCount] = {};
+    std::string unavailableReason;
+
+    ProfileStage current = ProfileStage::Count;
+    Reading last;
+    double totals[stageCount][counterCount] = {};
+    double nanoseconds[stageCount] = {};
+    uint64_t messages = 0;
+
+    static int openCounter(const CounterSpec& spec, int groupFd){
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = spec.type;
+        attr.config = spec.config;
+        attr.disabled = groupFd < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return int(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+
+    static std::string paranoidLevel(){
+        std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+        std::string level;
+        return file >> level ? level : std::string("unknown");
+    }
+
+    Reading read(){
+        Reading reading;
+        for(Group& group : groups){
+            if(group.leader < 0){
+                continue;
+            }
+            // nr, time enabled, time running, then one value per member
+            uint64_t data[3 + counterCount];
+            if(::read(group.leader, data, sizeof(data)) < ssize_t(3 * sizeof(uint64_t))){
+                continue;
+            }
+            double scale = data[2] ? double(data[1]) / double(data[2]) : 0.0;
+            for(size_t i = 0; i < group.members.size() && i < data[0]; i++){
+                reading.values[group.members[i]] = double(data[3 + i]) * scale;
+            }
+        }
+        reading.time = std::chrono::steady_clock::now();
+        return reading;
+    }
+
+    public:
+    StageProfiler(){
+        int firstError = 0;
+        std::string missing;
+        for(size_t i = 0; i < counterCount; i++){
+            Group& group = groups[specs[i].group];
+            int fd = openCounter(specs[i], group.leader);
+            if(fd < 0){
+                firstError = firstError ? firstError : errno;
+                missing += missing.empty() ? specs[i].name : std::string(" ") + specs[i].name;
+                continue;
+            }
+            if(group.leader < 0){
+                group.leader = fd;
+            }
+            group.members.push_back(i);
+            fds.push_back(fd);
+            available[i] = true;
+        }
+        for(Group& group : groups){
+            if(group.leader >= 0){
+                ioctl(group.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(group.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+        if(firstError){
+            unavailableReason = missing + " (" + std::strerror(firstError) + ", perf_event_paranoid " + paranoidLevel() + ")";
+            std::cerr << "[StageProfiler] " << (fds.empty() ? "No hardware counters" : "Some hardware counters are unavailable")
+                      << ": " << unavailableReason << ", reporting wall time" << (fds.empty() ? " only" : " and the rest") << std::endl;
+        }
+        last = read();
+    }
+
+    ~StageProfiler(){
+        for(int fd : fds){
+            close(fd);
+        }
+    }
+
+    StageProfiler(const StageProfiler&) = delete;
+    StageProfiler& operator=(const StageProfiler&) = delete;
+
+    // Attributes everything since the previous call to the stage that was running and starts stage.
+    void switchTo(ProfileStage stage){
+        Reading now = read();
+        if(current != ProfileStage::Count){
+            size_t index = size_t(current);
+            for(size_t i = 0; i < counterCount; i++){
+                totals[index][i] += now.values[i] - last.values[i];
+            }
+            nanoseconds[index] += double(std::chrono::duration_cast<std::chrono::nanoseconds>(now.time - last.time).count());
+        }
+        last = now;
+        current = stage;
+    }
+
+    void stop(){
+        switchTo(ProfileStage::Count);
+    }
+
+    void addMessages(uint64_t count){
+        messages += count;
+    }
+
+    // Per stage totals, IPC and per message rates. All stages divide by the messages parsed.
+    void report(std::ostream& out){
+        double perMessage = messages ? 1.0 / double(messages) : 0.0;
+        out << "[StageProfiler] " << messages << " messages";
+        if(!unavailableReason.empty()){
+            out << ", unavailable counters: " << unavailableReason;
+        }
+        out << "\n";
+        out << "stage,time_ms,ns_per_msg,cycles_per_msg,instructions_per_msg,ipc,l1d_misses_per_msg,llc_misses_per_msg,branch_misses_per_msg,dtlb_misses_per_msg,\n";
+        auto value = [this](size_t counter, double v){
+            std::ostringstream field;
+            if(available[counter]){
+                field << std::fixed << std::setprecision(3) << v;
+            }
+            else{
+                field << "-";
+            }
+            return field.str();
+        };
+        for(size_t stage = 0; stage < stageCount; stage++){
+            const double* counters = totals[stage];
+            out << stageName(ProfileStage(stage)) << "," << std::fixed << std::setprecision(3)
+                << nanoseconds[stage] / 1e6 << "," << nanoseconds[stage] * perMessage << ","
+                << value(0, counters[0] * perMessage) << "," << value(1, counters[1] * perMessage) << ","
+                << (available[0] && available[1] && counters[0] > 0 ? value(1, counters[1] / counters[0]) : std::string("-")) << ","
+                << value(3, counters[3] * perMessage) << "," << value(4, counters[4] * perMessage) << ","
+                << value(2, counters[2] * perMessage) << "," << value(5, counters[5] * perMessage) << ",\n";
+        }
+        out << std::defaultfloat;
+        out.flush();
+    }
+};
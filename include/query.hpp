@@ -0,0 +1,141 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include "parser.hpp"
+
+
+// Aggregates of all trades of one or more symbols inside a [t0, t1) window.
+struct WindowStats{
+    double vwap = 0.0;
+    double notional = 0.0;
+    uint64_t volume = 0;
+    uint64_t tradeCount = 0;
+};
+
+
+// Post-parse query engine over the trades kept by a Parser.
+// Every symbol's trades are stored time-sorted in columnar arrays together with prefix sums
+// of notional and volume, so any window is answered with two binary searches and a subtraction
+// instead of re-running the parse.
+class VWAPQueryEngine{
+
+    // Prefix sums carry a leading zero, so the window [i, j) is cum[j] - cum[i].
+    // Notional is kept in integer 1/10000 dollar units so subtracting large prefixes stays exact.
+    struct SymbolColumns{
+        std::vector<uint64_t> timestamps;
+        std::vector<uint64_t> cumNotional{0};
+        std::vector<uint64_t> cumVolume{0};
+    };
+
+    std::vector<SymbolColumns> columns;
+    std::unordered_map<std::string, uint16_t> symbolLocates;
+
+    static uint64_t toUInt(const Data& value){
+        return std::visit([](auto&& v) -> uint64_t { return static_cast<uint64_t>(v); }, value);
+    }
+
+    void accumulate(uint16_t stockLocate, uint64_t t0, uint64_t t1, WindowStats& stats) const {
+        if(stockLocate >= columns.size() || t1 <= t0){
+            return;
+        }
+        const SymbolColumns& symbol = columns[stockLocate];
+        size_t i = std::lower_bound(symbol.timestamps.begin(), symbol.timestamps.end(), t0) - symbol.timestamps.begin();
+        size_t j = std::lower_bound(symbol.timestamps.begin() + i, symbol.timestamps.end(), t1) - symbol.timestamps.begin();
+
+        stats.notional += (symbol.cumNotional[j] - symbol.cumNotional[i]) / 10000.0;
+        stats.volume += symbol.cumVolume[j] - symbol.cumVolume[i];
+        stats.tradeCount += j - i;
+    }
+
+    static void finalize(WindowStats& stats){
+        stats.vwap = stats.volume ? stats.notional / double(stats.volume) : 0.0;
+    }
+
+    // Rows are (timestamp, volume, price in ticks) in arrival order.
+    static void buildColumns(SymbolColumns& symbol, std::vector<std::tuple<uint64_t, uint64_t, uint64_t>>& rows){
+        std::stable_sort(rows.begin(), rows.end(), [](auto& a, auto& b){
+            return std::get<0>(a) < std::get<0>(b);
+        });
+
+        symbol.timestamps.reserve(rows.size());
+        symbol.cumNotional.reserve(rows.size() + 1);
+        symbol.cumVolume.reserve(rows.size() + 1);
+        for(auto& [ts, volume, priceTicks] : rows){
+            symbol.timestamps.push_back(ts);
+            symbol.cumNotional.push_back(symbol.cumNotional.back() + volume * priceTicks);
+            symbol.cumVolume.push_back(symbol.cumVolume.back() + volume);
+        }
+    }
+
+    public:
+    VWAPQueryEngine(const Parser& parser){
+        for(auto& [stockLocate, name] : parser.getStockMap()){
+            symbolLocates[std::string(name)] = stockLocate;
+        }
+
+        std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> rows;
+        if(parser.hasCompactTrades()){
+            const TradeTape& tape = parser.getTradeTape();
+            columns.resize(tape.begin() == tape.end() ? 1 : size_t(std::prev(tape.end())->first) + 1);
+            for(auto& [stockLocate, stockTrades] : tape){
+                rows.clear();
+                rows.reserve(stockTrades.size());
+                for(const TapeTrade& trade : stockTrades){
+                    rows.emplace_back(trade.timestamp, trade.shares, trade.price);
+                }
+                buildColumns(columns[stockLocate], rows);
+            }
+            return;
+        }
+
+        const auto& trades = parser.getTrades();
+        columns.resize(trades.empty() ? 1 : size_t(trades.rbegin()->first) + 1);
+        for(auto& [stockLocate, stockTrades] : trades){
+            rows.clear();
+            rows.reserve(stockTrades.size());
+            for(auto& [matchNumber, trade] : stockTrades){
+                uint64_t priceTicks = uint64_t(std::llround(std::get<double>(trade[2]) * 10000.0));
+                rows.emplace_back(toUInt(trade[0]), toUInt(trade[1]), priceTicks);
+            }
+            buildColumns(columns[stockLocate], rows);
+        }
+    }
+
+    // Returns the locate of a symbol, or 0 when the symbol is unknown (locates start at 1).
+    uint16_t locate(const std::string& symbol) const {
+        auto it = symbolLocates.find(symbol);
+        return it == symbolLocates.end() ? 0 : it->second;
+    }
+
+    WindowStats query(uint16_t stockLocate, uint64_t t0, uint64_t t1) const {
+        WindowStats stats;
+        accumulate(stockLocate, t0, t1, stats);
+        finalize(stats);
+        return stats;
+    }
+
+    // Combined VWAP, volume and trade count of a set of symbols over [t0, t1).
+    WindowStats query(const std::vector<std::string>& symbols, uint64_t t0, uint64_t t1) const {
+        WindowStats stats;
+        for(auto& symbol : symbols){
+            uint16_t stockLocate = locate(symbol);
+            if(stockLocate == 0){
+                std::cerr << "[VWAPQueryEngine] Symbol " << symbol << " not found!" << std::endl;
+                continue;
+            }
+            accumulate(stockLocate, t0, t1, stats);
+        }
+        finalize(stats);
+        return stats;
+    }
+};
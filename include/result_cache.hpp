@@ -0,0 +1,226 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <algorithm>
+#include <filesystem>
+#include <type_traits>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "mapped_file.hpp"
+
+
+// Cumulative price x volume and volume of one symbol up to the end of one hour, the stage the hourly
+// VWAP is computed from (vwap = cumulativePV / cumulativeVolume).
+struct HourlyAggregate{
+    char name[8];
+    uint16_t stockLocate;
+    uint16_t hour;
+    uint32_t reserved;
+    double cumulativePV;
+    uint64_t cumulativeVolume;
+};
+
+
+// 64 bit hash of a byte range, 8 bytes per step.
+inline uint64_t hashBytes(const char* data, size_t length, uint64_t seed = 0){
+    constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t hash = seed ^ (length * multiplier);
+    size_t i = 0;
+    for(; i + 8 <= length; i += 8){
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ (word * multiplier)) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    for(; i < length; i++){
+        hash = (hash ^ uint8_t(data[i])) * multiplier;
+    }
+    hash ^= hash >> 29;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    return hash ^ (hash >> 32);
+}
+
+
+// Results of earlier runs, stored by content address. An entry's key combines the input file's
+// size, modification time and a content digest (sampled blocks by default, every byte on request)
+// with a configuration string covering everything else that changes the results. Each stage is
+// its own entry, so a run that needs a different output from the same day still starts from the
+// cached aggregates instead of the raw file.
+// Entries are files in one directory; the least recently used ones are evicted above maxBytes.
+class ResultCache{
+    static constexpr char magic[8] = {'I', 'T', 'C', 'H', 'C', 'A', 'C', 'H'};
+    static constexpr size_t sampleBlocks = 16;
+    static constexpr size_t sampleBlockBytes = 1 << 16;
+
+    std::filesystem::path directory;
+    uint64_t maxBytes;
+    bool fullDigest;
+    std::mutex mutex;
+
+    std::filesystem::path entryPath(const std::string& key, const std::string& stage) const {
+        return directory / (key + "." + stage);
+    }
+
+    // Hits are touched, so eviction by modification time is least recently used.
+    static void touch(const std::filesystem::path& path){
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    }
+
+    void evict(){
+        std::error_code error;
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+        uint64_t total = 0;
+        for(auto& entry : std::filesystem::directory_iterator(directory, error)){
+            if(entry.is_regular_file(error) && entry.path().extension() != ".tmp"){
+                total += entry.file_size(error);
+                entries.push_back({entry.last_write_time(error), entry.path()});
+            }
+        }
+        std::sort(entries.begin(), entries.end());
+        for(auto& [time, path] : entries){
+            if(total <= maxBytes){
+                break;
+            }
+            uint64_t size = std::filesystem::file_size(path, error);
+            if(std::filesystem::remove(path, error)){
+                total -= size;
+            }
+        }
+    }
+
+    // Writes to a temporary file and renames it, readers never see a partial entry.
+    bool store(const std::filesystem::path& path, const char* data, size_t bytes){
+        std::lock_guard<std::mutex> lock(mutex);
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            out.write(data, std::streamsize(bytes));
+            if(!out){
+                std::cerr << "[ResultCache] Writing " << temporary << " failed" << std::endl;
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if(error){
+            std::cerr << "[ResultCache] Storing " << path << " failed: " << error.message() << std::endl;
+            return false;
+        }
+        evict();
+        return true;
+    }
+
+    public:
+    // An empty directory selects $XDG_CACHE_HOME/itch-vwap, else ~/.cache/itch-vwap.
+    ResultCache(std::string cacheDirectory, uint64_t maxBytes, bool fullDigest = false) : maxBytes(maxBytes), fullDigest(fullDigest) {
+        if(cacheDirectory.empty()){
+            const char* xdg = std::getenv("XDG_CACHE_HOME");
+            const char* home = std::getenv("HOME");
+            directory = xdg && *xdg ? std::filesystem::path(xdg) / "itch-vwap"
+                                    : std::filesystem::path(home ? home : ".") / ".cache" / "itch-vwap";
+        }
+        else{
+            directory = cacheDirectory;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if(error){
+            std::cerr << "[ResultCache] Cannot create " << directory << ": " << error.message() << std::endl;
+        }
+    }
+
+    // Key of one input file under one configuration, empty when the file cannot be read.
+    std::string key(const std::string& filePath, const std::string& configuration) const {
+        struct stat info;
+        if(stat(filePath.c_str(), &info) != 0){
+            return std::string();
+        }
+        MappedFile file(filePath);
+        const char* data = file.data();
+        size_t size = file.size();
+        uint64_t digest = hashBytes(configuration.data(), configuration.size(), uint64_t(size));
+        digest = hashBytes(reinterpret_cast<const char*>(&info.st_mtim), sizeof(info.st_mtim), digest);
+        if(fullDigest || size <= (sampleBlocks + 2) * sampleBlockBytes){
+            digest = hashBytes(data, size, digest);
+        }
+        else{
+            // First and last block, and evenly spaced ones in between
+            digest = hashBytes(data, sampleBlockBytes, digest);
+            for(size_t i = 1; i <= sampleBlocks; i++){
+                digest = hashBytes(data + (size - sampleBlockBytes) / (sampleBlocks + 1) * i, sampleBlockBytes, digest);
+            }
+            digest = hashBytes(data + size - sampleBlockBytes, sampleBlockBytes, digest);
+        }
+        std::ostringstream text;
+        text << std::hex << std::setw(16) << std::setfill('0') << digest << "-" << std::dec << size;
+        return text.str();
+    }
+
+    // Fixed size records, behind a magic and a record count.
+    template<typename Record>
+    bool storeRecords(const std::string& key, const std::string& stage, const std::vector<Record>& records){
+        static_assert(std::is_trivially_copyable<Record>::value, "Cached records must be trivially copyable");
+        std::string bytes(magic, sizeof(magic));
+        uint64_t count = records.size();
+        bytes.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        bytes.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        return store(entryPath(key, stage), bytes.data(), bytes.size());
+    }
+
+    template<typename Record>
+    bool loadRecords(const std::string& key, const std::string& stage, std::vector<Record>& records){
+        std::filesystem::path path = entryPath(key, stage);
+        std::ifstream in(path, std::ios::binary);
+        char header[sizeof(magic)];
+        uint64_t count;
+        if(!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0 || !in.read(reinterpret_cast<char*>(&count), sizeof(count))){
+            return false;
+        }
+        records.resize(count);
+        if(!in.read(reinterpret_cast<char*>(records.data()), std::streamsize(count * sizeof(Record)))){
+            records.clear();
+            return false;
+        }
+        touch(path);
+        return true;
+    }
+
+    // Copies an output file into the cache.
+    bool storeFile(const std::string& key, const std::string& stage, const std::string& filePath){
+        MappedFile file(filePath);
+        if(!file.data() && file.size() != 0){
+            return false;
+        }
+        return store(entryPath(key, stage), file.data(), file.size());
+    }
+
+    // Copies a cached output file to filePath, false on a miss.
+    bool loadFile(const std::string& key, const std::string& stage, const std::string& filePath){
+        std::filesystem::path path = entryPath(key, stage);
+        std::error_code error;
+        if(!std::filesystem::is_regular_file(path, error)){
+            return false;
+        }
+        std::filesystem::copy_file(path, filePath, std::filesystem::copy_options::overwrite_existing, error);
+        if(error){
+            std::cerr << "[ResultCache] Copying " << path << " failed: " << error.message() << std::endl;
+            return false;
+        }
+        touch(path);
+        return true;
+    }
+};
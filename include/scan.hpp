@@ -0,0 +1,151 @@
+#ifndef SCAN_HPP
+#define SCAN_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <array>
+#include <vector>
+#include <chrono>
+#include "message.hpp"
+#include "mapped_file.hpp"
+
+
+// File profile gathered by scanMessages(). Byte totals include the 2 byte length prefixes,
+// so they add up to the file size minus trailingBytes.
+struct ScanStats{
+    uint64_t fileBytes = 0;
+    uint64_t messages = 0;
+    uint64_t symbols = 0;
+    // Messages whose length differs from the ITCH 5.0 size of their type, and bytes of a truncated last message.
+    uint64_t malformed = 0;
+    uint64_t trailingBytes = 0;
+    double seconds = 0.0;
+    std::array<uint64_t, 256> counts{};
+    std::array<uint64_t, 256> bytes{};
+    std::array<uint64_t, 25> hourly{};
+};
+
+
+inline const char* messageTypeName(char type){
+    switch(type){
+        case 'S': return "System Event";
+        case 'R': return "Stock Directory";
+        case 'H': return "Stock Trading Action";
+        case 'Y': return "Reg SHO Restriction";
+        case 'L': return "Market Participant Position";
+        case 'V': return "MWCB Decline Level";
+        case 'W': return "MWCB Status";
+        case 'K': return "Quoting Period Update";
+        case 'J': return "LULD Auction Collar";
+        case 'h': return "Operational Halt";
+        case 'A': return "Add Order";
+        case 'F': return "Add Order (MPID)";
+        case 'E': return "Order Executed";
+        case 'C': return "Order Executed With Price";
+        case 'X': return "Order Cancel";
+        case 'D': return "Order Delete";
+        case 'U': return "Order Replace";
+        case 'P': return "Trade (Non-Cross)";
+        case 'Q': return "Cross Trade";
+        case 'B': return "Broken Trade";
+        case 'I': return "NOII";
+        case 'O': return "DLCR Price Discovery";
+        case 'N': return "RPII";
+        default: return "Unknown";
+    }
+}
+
+
+// Walks only the length prefixes, type bytes and timestamps of a mapped file. No message is
+// decoded and no order or trade state is touched, so the pass runs at about memory bandwidth
+// and works as a quick sanity check of a new file before the full parse().
+inline ScanStats scanMessages(const std::string& filePath){
+    constexpr uint64_t nanosecondsPerHour = 3600ULL * 1000000000ULL;
+    auto start = std::chrono::steady_clock::now();
+    ScanStats stats;
+
+    // Expected message length (type byte included) per type, 0 for types outside the spec.
+    std::array<uint16_t, 256> expected{};
+    for(auto& [type, size] : packet_sizes){
+        expected[uint8_t(type)] = uint16_t(size + 1);
+    }
+    std::vector<bool> listed(size_t(UINT16_MAX) + 1, false);
+
+    MappedFile file(filePath);
+    file.adviseSequential();
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(file.data());
+    const uint8_t* end = p + file.size();
+    stats.fileBytes = file.size();
+
+    size_t hour = 0;
+    uint64_t hourStart = 0, hourEnd = 0;
+    while(end - p >= 3){
+        size_t length = (size_t(p[0]) << 8) | p[1];
+        if(length == 0 || size_t(end - p) - 2 < length){
+            break;
+        }
+        uint8_t type = p[2];
+        stats.counts[type]++;
+        stats.bytes[type] += length + 2;
+        stats.malformed += expected[type] != length;
+
+        if(length >= 11){
+            uint64_t ts = 0;
+            for(int i = 7; i < 13; i++){
+                ts = (ts << 8) | p[i];
+            }
+            // Timestamps are (nearly) ordered, so the division is only needed when the hour changes.
+            if(ts < hourStart || ts >= hourEnd){
+                hour = std::min<size_t>(ts / nanosecondsPerHour, stats.hourly.size() - 1);
+                hourStart = hour * nanosecondsPerHour;
+                hourEnd = hourStart + nanosecondsPerHour;
+            }
+            stats.hourly[hour]++;
+            if(type == 'R'){
+                uint16_t stockLocate = uint16_t((p[3] << 8) | p[4]);
+                stats.symbols += !listed[stockLocate];
+                listed[stockLocate] = true;
+            }
+        }
+        stats.messages++;
+        p += 2 + length;
+    }
+    stats.trailingBytes = uint64_t(end - p);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+
+inline void printScanReport(const ScanStats& stats, std::ostream& out){
+    double gigabytes = stats.fileBytes / 1e9;
+    out << "[scan] " << stats.messages << " messages, " << stats.fileBytes << " bytes in " << stats.seconds << " s ("
+        << (stats.seconds > 0 ? gigabytes / stats.seconds : 0.0) << " GB/s)\n";
+
+    out << "type,name,count,bytes,share,\n";
+    for(size_t type = 0; type < stats.counts.size(); type++){
+        if(stats.counts[type] == 0){
+            continue;
+        }
+        double share = stats.messages ? 100.0 * stats.counts[type] / stats.messages : 0.0;
+        out << char(type) << "," << messageTypeName(char(type)) << "," << stats.counts[type] << "," << stats.bytes[type] << ","
+            << std::fixed << std::setprecision(2) << share << "%,\n" << std::defaultfloat << std::setprecision(6);
+    }
+
+    out << "hour,messages,per_second,\n";
+    for(size_t hour = 0; hour < stats.hourly.size(); hour++){
+        if(stats.hourly[hour] == 0){
+            continue;
+        }
+        out << std::setw(2) << std::setfill('0') << hour << ":00" << std::setfill(' ') << ","
+            << stats.hourly[hour] << "," << stats.hourly[hour] / 3600.0 << ",\n";
+    }
+
+    out << "symbols," << stats.symbols << ",\n";
+    out << "malformed," << stats.malformed << ",\n";
+    out << "trailing_bytes," << stats.trailingBytes << ",\n";
+}
@@ -0,0 +1,213 @@
+#ifndef SCHEMA_HPP
+#define SCHEMA_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <cstring>
+#include <type_traits>
+#include "utils.hpp"
+
+
+// How a field is stored on the wire and printed. Prices are big-endian integers with 4 (Price4)
+// or 8 (Price8) implied decimals; the structs keep the raw integer and only printers scale it.
+enum class FieldKind{ Integer, Alpha, Price4, Price8 };
+
+
+// Big-endian unsigned load of a compile-time width, a single bswap for the power of two widths.
+template<size_t Width>
+inline uint64_t loadBigEndian(const char* p){
+    static_assert(Width >= 1 && Width <= 8, "ITCH integers are 1 to 8 bytes wide");
+    if constexpr(Width == 1){
+        return uint8_t(p[0]);
+    }
+    else if constexpr(Width == 2){
+        uint16_t value;
+        std::memcpy(&value, p, 2);
+        return __builtin_bswap16(value);
+    }
+    else if constexpr(Width == 4){
+        uint32_t value;
+        std::memcpy(&value, p, 4);
+        return __builtin_bswap32(value);
+    }
+    else if constexpr(Width == 8){
+        uint64_t value;
+        std::memcpy(&value, p, 8);
+        return __builtin_bswap64(value);
+    }
+    else{
+        uint64_t value = 0;
+        for(size_t i = 0; i < Width; i++){
+            value = (value << 8) | uint8_t(p[i]);
+        }
+        return value;
+    }
+}
+
+template<size_t Width>
+inline void storeBigEndian(char* p, uint64_t value){
+    for(size_t i = 0; i < Width; i++){
+        p[Width - 1 - i] = char(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+
+// One entry of a message schema: the struct member it fills, its byte offset in the message
+// (the type byte is offset 0), its width on the wire and its kind. Offset, width and kind are part
+// of the type, so every generated load is a constant-offset load the compiler can unroll.
+template<auto Member, size_t Offset, size_t Width, FieldKind Kind = FieldKind::Integer>
+struct Field{
+    static constexpr size_t offset = Offset;
+    static constexpr size_t width = Width;
+    static constexpr FieldKind kind = Kind;
+    const char* name;
+
+    template<typename Message>
+    static void decode(const char* message, Message& msg){
+        auto& value = msg.*Member;
+        using Value = std::remove_reference_t<decltype(value)>;
+        if constexpr(std::is_array_v<Value>){
+            static_assert(sizeof(Value) == Width, "Alpha fields are stored in a char array of their width");
+            std::memcpy(value, message + Offset, Width);
+        }
+        else if constexpr(std::is_same_v<Value, char>){
+            static_assert(Width == 1, "char fields are 1 byte wide");
+            value = message[Offset];
+        }
+        else{
+            static_assert(sizeof(Value) >= Width, "Integer member is narrower than its field");
+            value = Value(loadBigEndian<Width>(message + Offset));
+        }
+    }
+
+    template<typename Message>
+    static void encode(const Message& msg, char* message){
+        auto& value = msg.*Member;
+        using Value = std::remove_cv_t<std::remove_reference_t<decltype(value)>>;
+        if constexpr(std::is_array_v<Value>){
+            std::memcpy(message + Offset, value, Width);
+        }
+        else if constexpr(std::is_same_v<Value, char>){
+            message[Offset] = value;
+        }
+        else{
+            storeBigEndian<Width>(message + Offset, uint64_t(value));
+        }
+    }
+
+    template<typename Message>
+    static void print(std::ostream& out, const Message& msg){
+        auto& value = msg.*Member;
+        using Value = std::remove_cv_t<std::remove_reference_t<decltype(value)>>;
+        if constexpr(std::is_array_v<Value>){
+            out << rstrip(std::string(value, sizeof(Value)));
+        }
+        else if constexpr(Kind == FieldKind::Price4){
+            out << value / 10000.0;
+        }
+        else if constexpr(Kind == FieldKind::Price8){
+            out << value / 1e8;
+        }
+        else if constexpr(std::is_same_v<Value, char>){
+            out << value;
+        }
+        else{
+            out << uint64_t(value);
+        }
+    }
+};
+
+
+// Every message struct specializes Schema with its type byte, total size (type byte included),
+// title and a constexpr tuple of Fields.
+template<typename Message>
+struct Schema;
+
+// Fields common to every ITCH 5.0 message.
+template<typename Message>
+constexpr auto headerFields(){
+    return std::make_tuple(
+        Field<&Message::stockLocate, 1, 2>{"Stock Locate"},
+        Field<&Message::trackingNumber, 3, 2>{"Tracking Number"},
+        Field<&Message::timestamp, 5, 6>{"Timestamp"}
+    );
+}
+
+template<typename Message, typename F>
+inline void forEachField(F&& fn){
+    std::apply([&fn](auto&... field){ (fn(field), ...); }, Schema<Message>::fields);
+}
+
+
+// message points at the type byte and holds at least Schema<Message>::size bytes.
+template<typename Message>
+inline void decodeMessage(const char* message, Message& msg){
+    std::apply([message, &msg](auto&... field){ (field.decode(message, msg), ...); }, Schema<Message>::fields);
+}
+
+// Writes the wire format (type byte first, without the length prefix) into Schema<Message>::size bytes.
+template<typename Message>
+inline void encodeMessage(const Message& msg, char* message){
+    message[0] = Schema<Message>::type;
+    std::apply([message, &msg](auto&... field){ (field.encode(msg, message), ...); }, Schema<Message>::fields);
+}
+
+template<typename Message>
+inline void printMessage(std::ostream& out, const Message& msg){
+    forEachField<Message>([&out, &msg](auto& field){
+        out << field.name << " -> ";
+        field.print(out, msg);
+        out << "\n";
+    });
+}
+
+template<typename Message>
+inline void writeCSVHeader(std::ostream& out){
+    forEachField<Message>([&out](auto& field){
+        out << field.name << ",";
+    });
+    out << "\n";
+}
+
+template<typename Message>
+inline void writeCSV(std::ostream& out, const Message& msg){
+    forEachField<Message>([&out, &msg](auto& field){
+        field.print(out, msg);
+        out << ",";
+    });
+    out << "\n";
+}
+
+// Binary serialization is the ITCH wire format itself, length prefix included.
+template<typename Message>
+inline void writeBinary(std::ostream& out, const Message& msg){
+    char buffer[2 + Schema<Message>::size];
+    storeBigEndian<2>(buffer, Schema<Message>::size);
+    encodeMessage(msg, buffer + 2);
+    out.write(buffer, sizeof(buffer));
+}
+
+
+// Gives every message struct the stream based load() and show() of the original hand written structs.
+// load() expects the type byte to be consumed already, like parse() used to read it.
+template<typename Message>
+struct MessageBase{
+    void load(std::ifstream& file){
+        char message[Schema<Message>::size];
+        message[0] = Schema<Message>::type;
+        file.read(message + 1, Schema<Message>::size - 1);
+        decodeMessage(message, static_cast<Message&>(*this));
+    }
+
+    void show() const {
+        printMessage(std::cout, static_cast<const Message&>(*this));
+        std::cout.flush();
+    }
+};
@@ -0,0 +1,270 @@
+#ifndef SEGMENTS_HPP
+#define SEGMENTS_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "parser.hpp"
+#include "mapped_file.hpp"
+
+
+// A segment file holds a day file's messages regrouped into one contiguous, timestamp ordered
+// segment per stock locate, in the original wire format (length prefixes included). Segment 0 holds
+// the messages without a locate (System Events). The directory and trailer follow the segments.
+struct SegmentEntry{
+    uint64_t offset;
+    uint64_t bytes;
+    uint64_t messages;
+    char stock[8];
+    uint16_t stockLocate;
+    uint8_t reserved[6];
+};
+
+struct SegmentTrailer{
+    uint64_t directoryOffset;
+    uint64_t segmentCount;
+    char magic[8];
+};
+
+constexpr char segmentMagic[8] = {'I', 'T', 'C', 'H', 'S', 'E', 'G', 'S'};
+
+
+// One time demultiplexing of a day file into a segment file. The first pass only walks the length
+// prefixes to size every segment, the second copies each message to its segment's cursor through a
+// small per-segment buffer, so memory stays bounded however large the day is.
+// Returns the number of segments written, 0 on error.
+inline size_t demuxSegments(const std::string& inputPath, const std::string& outputPath){
+    constexpr size_t maxSegmentBuffer = 1 << 16;
+    MappedFile input(inputPath);
+    input.adviseSequential();
+    const char* begin = input.data();
+    const char* end = begin + input.size();
+
+    std::vector<SegmentEntry> entries(size_t(UINT16_MAX) + 1, SegmentEntry{});
+    const char* p = begin;
+    while(end - p >= 3){
+        size_t length = (size_t(uint8_t(p[0])) << 8) | uint8_t(p[1]);
+        if(length == 0 || size_t(end - p) - 2 < length){
+            break;
+        }
+        uint16_t stockLocate = length >= 3 ? uint16_t(loadBigEndian<2>(p + 3)) : 0;
+        SegmentEntry& entry = entries[stockLocate];
+        entry.bytes += length + 2;
+        entry.messages++;
+        if(p[2] == 'R' && length >= 11 + sizeof(entry.stock)){
+            std::memcpy(entry.stock, p + 2 + 11, sizeof(entry.stock));
+        }
+        p += 2 + length;
+    }
+    const char* dataEnd = p;
+    if(dataEnd != end){
+        std::cerr << "[demux] Ignoring " << (end - dataEnd) << " trailing bytes of " << inputPath << std::endl;
+    }
+
+    std::vector<SegmentEntry> directory;
+    uint64_t offset = 0;
+    for(size_t stockLocate = 0; stockLocate < entries.size(); stockLocate++){
+        SegmentEntry& entry = entries[stockLocate];
+        if(entry.messages == 0){
+            continue;
+        }
+        if(entry.stock[0] == '\0'){
+            std::memset(entry.stock, ' ', sizeof(entry.stock));
+        }
+        entry.stockLocate = uint16_t(stockLocate);
+        entry.offset = offset;
+        offset += entry.bytes;
+        directory.push_back(entry);
+    }
+
+    int fd = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        std::cerr << "[demux] Cannot open " << outputPath << std::endl;
+        return 0;
+    }
+    bool ok = true;
+    auto writeAt = [fd, &ok](const char* data, size_t bytes, uint64_t at){
+        while(ok && bytes > 0){
+            ssize_t written = pwrite(fd, data, bytes, off_t(at));
+            ok = written > 0;
+            data += written;
+            bytes -= size_t(written);
+            at += uint64_t(written);
+        }
+    };
+
+    // Cursor and pending bytes of every segment, indexed like directory.
+    std::vector<size_t> segmentOf(entries.size(), 0);
+    std::vector<uint64_t> cursors(directory.size());
+    std::vector<std::vector<char>> buffers(directory.size());
+    for(size_t i = 0; i < directory.size(); i++){
+        segmentOf[directory[i].stockLocate] = i;
+        cursors[i] = directory[i].offset;
+        buffers[i].reserve(std::min<size_t>(directory[i].bytes, maxSegmentBuffer));
+    }
+    for(p = begin; p < dataEnd && ok; ){
+        size_t length = (size_t(uint8_t(p[0])) << 8) | uint8_t(p[1]);
+        size_t segment = segmentOf[length >= 3 ? uint16_t(loadBigEndian<2>(p + 3)) : 0];
+        std::vector<char>& buffer = buffers[segment];
+        if(buffer.size() + length + 2 > buffer.capacity()){
+            writeAt(buffer.data(), buffer.size(), cursors[segment]);
+            cursors[segment] += buffer.size();
+            buffer.clear();
+        }
+        buffer.insert(buffer.end(), p, p + 2 + length);
+        p += 2 + length;
+    }
+    for(size_t i = 0; i < directory.size(); i++){
+        writeAt(buffers[i].data(), buffers[i].size(), cursors[i]);
+    }
+
+    SegmentTrailer trailer{offset, directory.size(), {}};
+    std::memcpy(trailer.magic, segmentMagic, sizeof(segmentMagic));
+    writeAt(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(SegmentEntry), offset);
+    writeAt(reinterpret_cast<const char*>(&trailer), sizeof(trailer), offset + directory.size() * sizeof(SegmentEntry));
+    close(fd);
+    if(!ok){
+        std::cerr << "[demux] Writing " << outputPath << " failed" << std::endl;
+        return 0;
+    }
+    return directory.size();
+}
+
+
+// Read side of a segment file. Segments are mapped, so a run over a few symbols only reads their bytes.
+class SegmentFile{
+    MappedFile file;
+    std::vector<SegmentEntry> directory;
+
+    public:
+    SegmentFile(const std::string& filePath) : file(filePath) {
+        SegmentTrailer trailer;
+        if(file.size() < sizeof(trailer)){
+            std::cerr << "[SegmentFile] " << filePath << " is not a segment file" << std::endl;
+            return;
+        }
+        std::memcpy(&trailer, file.data() + file.size() - sizeof(trailer), sizeof(trailer));
+        if(std::memcmp(trailer.magic, segmentMagic, sizeof(segmentMagic)) != 0
+           || trailer.directoryOffset + trailer.segmentCount * sizeof(SegmentEntry) + sizeof(trailer) != file.size()){
+            std::cerr << "[SegmentFile] " << filePath << " is not a segment file" << std::endl;
+            return;
+        }
+        directory.resize(trailer.segmentCount);
+        std::memcpy(directory.data(), file.data() + trailer.directoryOffset, directory.size() * sizeof(SegmentEntry));
+    }
+
+    const std::vector<SegmentEntry>& segments() const {
+        return directory;
+    }
+
+    const char* data(const SegmentEntry& entry) const {
+        return file.data() + entry.offset;
+    }
+};
+
+
+// Reruns the engine over a segment file with every symbol processed independently: worker threads
+// take whole segments, largest first, each with its own Parser that is reset after every segment.
+// The hourly VWAP is collected per stock locate and written in the same order and format as
+// writeVWAP(). The System Event segment is skipped, so incremental output is not available here.
+class SegmentRunner{
+    SegmentFile segmentFile;
+    std::string finalVWAPFilePath;
+    size_t numWorkers;
+    std::set<std::string> symbolFilter;
+
+    std::vector<const SegmentEntry*> jobs;
+    std::atomic<size_t> nextJob{0};
+    std::mutex resultMutex;
+    std::map<uint16_t, std::pair<std::string, std::map<uint16_t, double>>> results;
+
+    void worker(){
+        ParserArena arena;
+        Parser parser = Parser("", &arena);
+        parser.setVWAPConsumer([](const VWAPRecord&){});
+        Event msg;
+        for(size_t job = nextJob++; job < jobs.size(); job = nextJob++){
+            const SegmentEntry& entry = *jobs[job];
+            const char* p = segmentFile.data(entry);
+            const char* end = p + entry.bytes;
+            while(end - p >= 2){
+                size_t length = (size_t(uint8_t(p[0])) << 8) | uint8_t(p[1]);
+                if(size_t(end - p) - 2 < length){
+                    std::cerr << "[SegmentFile] Truncated message in segment of locate " << entry.stockLocate << std::endl;
+                    break;
+                }
+                decodeEvent(p + 2, length, msg);
+                msg.offset = uint64_t(p - segmentFile.data(entry)) + entry.offset;
+                parser.apply(msg);
+                p += 2 + length;
+            }
+            parser.processRunningVWAP();
+
+            {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                for(auto& [stockLocate, hourlyVWAP] : parser.getVWAP()){
+                    auto it = parser.getStockMap().find(stockLocate);
+                    auto& result = results[stockLocate];
+                    result.first = it == parser.getStockMap().end() ? std::string() : std::string(it->second);
+                    result.second.insert(hourlyVWAP.begin(), hourlyVWAP.end());
+                }
+            }
+            parser.reset("");
+        }
+    }
+
+    public:
+    // An empty symbols list runs every segment.
+    SegmentRunner(const std::string& segmentPath, std::string finalVWAPFilePath, size_t numWorkers = 0, const std::vector<std::string>& symbols = {})
+        : segmentFile(segmentPath), finalVWAPFilePath(finalVWAPFilePath), numWorkers(numWorkers), symbolFilter(symbols.begin(), symbols.end()) {
+        for(auto& entry : segmentFile.segments()){
+            if(entry.stockLocate == 0){
+                continue;
+            }
+            if(symbolFilter.empty() || symbolFilter.count(rstrip(std::string(entry.stock, sizeof(entry.stock))))){
+                jobs.push_back(&entry);
+            }
+        }
+        std::stable_sort(jobs.begin(), jobs.end(), [](const SegmentEntry* a, const SegmentEntry* b){
+            return a->bytes > b->bytes;
+        });
+        if(this->numWorkers == 0){
+            this->numWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        this->numWorkers = std::min(this->numWorkers, std::max<size_t>(jobs.size(), 1));
+    }
+
+    void run(){
+        std::cout << "[segments] " << jobs.size() << " segment(s) on " << numWorkers << " worker(s)" << std::endl;
+        std::vector<std::thread> workers;
+        for(size_t i = 0; i < numWorkers; i++){
+            workers.emplace_back(&SegmentRunner::worker, this);
+        }
+        for(auto& thread : workers){
+            thread.join();
+        }
+
+        std::ofstream finVWAP;
+        finVWAP.open(finalVWAPFilePath);
+        finVWAP << "name,hour,vwap,\n";
+        for(auto& [stockLocate, result] : results){
+            for(auto& [hour, vwap] : result.second){
+                finVWAP << result.first << "," << hour << "," << vwap << ",\n";
+            }
+        }
+    }
+};
@@ -0,0 +1,458 @@
+#ifndef SHARD_HPP
+#define SHARD_HPP
+#endif
+
+#pragma once
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <sched.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "parser.hpp"
+
+
+// Where the ShardCoordinator listens: "unix:/path/to/socket" for workers on the same host,
+// "tcp:host:port" for workers on other hosts.
+struct ShardAddress{
+    bool tcp = false;
+    std::string path;
+    std::string host;
+    std::string port;
+
+    static ShardAddress parse(const std::string& address){
+        ShardAddress parsed;
+        if(address.rfind("tcp:", 0) == 0){
+            std::string hostPort = address.substr(4);
+            size_t colon = hostPort.rfind(':');
+            parsed.tcp = true;
+            parsed.host = colon == std::string::npos ? "" : hostPort.substr(0, colon);
+            parsed.port = colon == std::string::npos ? hostPort : hostPort.substr(colon + 1);
+        }
+        else{
+            parsed.path = address.rfind("unix:", 0) == 0 ? address.substr(5) : address;
+        }
+        return parsed;
+    }
+};
+
+
+// Coordinator and workers exchange fixed size records in host byte order, so every host of a
+// sharded run must share the same endianness.
+constexpr char shardMagic[8] = {'I', 'T', 'C', 'H', 'S', 'H', 'R', 'D'};
+
+struct ShardAssignment{
+    uint32_t shard;
+    uint32_t shardCount;
+    // Inclusive, firstLocate > lastLocate for an empty shard.
+    uint16_t firstLocate;
+    uint16_t lastLocate;
+    uint8_t reserved[4];
+};
+
+struct ShardResult{
+    uint64_t recordCount;
+    uint64_t elapsedMicros;
+};
+
+
+inline bool sendAll(int socketFd, const void* data, size_t size){
+    const char* p = static_cast<const char*>(data);
+    while(size > 0){
+        ssize_t sent = send(socketFd, p, size, MSG_NOSIGNAL);
+        if(sent <= 0){
+            return false;
+        }
+        p += sent;
+        size -= size_t(sent);
+    }
+    return true;
+}
+
+inline bool recvAll(int socketFd, void* data, size_t size){
+    char* p = static_cast<char*>(data);
+    while(size > 0){
+        ssize_t received = recv(socketFd, p, size, 0);
+        if(received <= 0){
+            return false;
+        }
+        p += received;
+        size -= size_t(received);
+    }
+    return true;
+}
+
+inline int listenOn(const ShardAddress& address, int backlog){
+    int socketFd = -1;
+    if(address.tcp){
+        addrinfo hints{}, *result = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        if(getaddrinfo(address.host.empty() ? nullptr : address.host.c_str(), address.port.c_str(), &hints, &result) != 0){
+            std::cerr << "[ShardCoordinator] Cannot resolve " << address.host << ":" << address.port << std::endl;
+            return -1;
+        }
+        for(addrinfo* candidate = result; candidate; candidate = candidate->ai_next){
+            socketFd = socket(candidate->ai_family, candidate->ai_socktype | SOCK_CLOEXEC, candidate->ai_protocol);
+            if(socketFd < 0){
+                continue;
+            }
+            int reuse = 1;
+            setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if(bind(socketFd, candidate->ai_addr, candidate->ai_addrlen) == 0){
+                break;
+            }
+            close(socketFd);
+            socketFd = -1;
+        }
+        freeaddrinfo(result);
+    }
+    else{
+        sockaddr_un local{};
+        local.sun_family = AF_UNIX;
+        if(address.path.size() >= sizeof(local.sun_path)){
+            std::cerr << "[ShardCoordinator] Socket path " << address.path << " is too long" << std::endl;
+            return -1;
+        }
+        std::strcpy(local.sun_path, address.path.c_str());
+        unlink(address.path.c_str());
+        socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(socketFd >= 0 && bind(socketFd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0){
+            close(socketFd);
+            socketFd = -1;
+        }
+    }
+    if(socketFd < 0 || listen(socketFd, backlog) != 0){
+        std::cerr << "[ShardCoordinator] Cannot listen on " << (address.tcp ? address.host + ":" + address.port : address.path) << std::endl;
+        if(socketFd >= 0){
+            close(socketFd);
+        }
+        return -1;
+    }
+    return socketFd;
+}
+
+// Workers may start before the coordinator listens, so connecting is retried for a while.
+inline int connectTo(const ShardAddress& address, int timeoutMillis = 10000){
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while(true){
+        int socketFd = -1;
+        if(address.tcp){
+            addrinfo hints{}, *result = nullptr;
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            if(getaddrinfo(address.host.empty() ? "localhost" : address.host.c_str(), address.port.c_str(), &hints, &result) == 0){
+                for(addrinfo* candidate = result; candidate && socketFd < 0; candidate = candidate->ai_next){
+                    socketFd = socket(candidate->ai_family, candidate->ai_socktype | SOCK_CLOEXEC, candidate->ai_protocol);
+                    if(socketFd >= 0 && connect(socketFd, candidate->ai_addr, candidate->ai_addrlen) != 0){
+                        close(socketFd);
+                        socketFd = -1;
+                    }
+                }
+                freeaddrinfo(result);
+            }
+            if(socketFd >= 0){
+                int noDelay = 1;
+                setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            }
+        }
+        else{
+            sockaddr_un remote{};
+            remote.sun_family = AF_UNIX;
+            std::strncpy(remote.sun_path, address.path.c_str(), sizeof(remote.sun_path) - 1);
+            socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(socketFd >= 0 && connect(socketFd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0){
+                close(socketFd);
+                socketFd = -1;
+            }
+        }
+        if(socketFd >= 0 || std::chrono::steady_clock::now() >= deadline){
+            return socketFd;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+
+// CPUs of every NUMA node from sysfs, a single entry with no CPUs when the host has one node.
+inline std::vector<std::vector<int>> numaNodeCpus(){
+    std::vector<std::vector<int>> nodes;
+    for(int node = 0; ; node++){
+        std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if(!cpuList){
+            break;
+        }
+        std::vector<int> cpus;
+        std::string range;
+        while(std::getline(cpuList, range, ',')){
+            // Memory only nodes have an empty list.
+            if(range.empty() || !std::isdigit(uint8_t(range[0]))){
+                continue;
+            }
+            size_t dash = range.find('-');
+            int first = std::stoi(range);
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; cpu++){
+                cpus.push_back(cpu);
+            }
+        }
+        nodes.push_back(cpus);
+    }
+    if(nodes.size() <= 1){
+        return {{}};
+    }
+    return nodes;
+}
+
+
+// Worker side of a sharded run: receives a stock locate range from the coordinator, runs the full
+// parse / book / VWAP engine for the symbols of that range only and sends the hourly VWAP back.
+// Every worker reads the whole file, but the order book, the trades and the VWAP state of the other
+// shards are never touched, so the memory traffic per process shrinks with the number of workers.
+inline int runShardWorker(const std::string& address, const std::string& filePath){
+    int socketFd = connectTo(ShardAddress::parse(address));
+    if(socketFd < 0){
+        std::cerr << "[ShardWorker] Cannot connect to " << address << std::endl;
+        return 1;
+    }
+    ShardAssignment assignment;
+    if(!sendAll(socketFd, shardMagic, sizeof(shardMagic)) || !recvAll(socketFd, &assignment, sizeof(assignment))){
+        std::cerr << "[ShardWorker] Coordinator " << address << " closed the connection" << std::endl;
+        close(socketFd);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<VWAPRecord> records;
+    ParserArena arena;
+    {
+        Parser parser = Parser(filePath, &arena);
+        parser.setLocateRange(assignment.firstLocate, assignment.lastLocate);
+        parser.setVWAPConsumer([&records](const VWAPRecord& record){ records.push_back(record); });
+        parser.parse();
+        parser.processRunningVWAP();
+    }
+    ShardResult result{records.size(), uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count())};
+
+    bool sent = sendAll(socketFd, &result, sizeof(result)) && sendAll(socketFd, records.data(), records.size() * sizeof(VWAPRecord));
+    close(socketFd);
+    if(!sent){
+        std::cerr << "[ShardWorker] Sending the results of shard " << assignment.shard << " failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+// Splits one day file across worker processes by stock locate and merges their hourly VWAP into
+// the file writeVWAP() produces for a single process run. Shards are contiguous locate ranges
+// with about the same number of symbols, so concatenating the shards' results in shard order keeps
+// writeVWAP()'s locate order. Workers connect over a Unix domain socket or TCP and may be started
+// by hand on other hosts (bin/main --shard-worker ADDRESS FILE) or forked locally with spawnLocalWorkers().
+class ShardCoordinator{
+    std::string filePath;
+    std::string address;
+    std::string finalVWAPFilePath;
+    size_t shardCount;
+    int acceptTimeoutSeconds;
+    std::vector<pid_t> children;
+    bool workerFailed = false;
+
+    // Stock Directory messages are sent before the first order, so only the start of the file is read.
+    std::vector<uint16_t> listedLocates(){
+        std::vector<uint16_t> locates;
+        FrameReader reader(filePath);
+        size_t length;
+        while(const char* message = reader.next(length)){
+            if(message[0] == 'A' || message[0] == 'F'){
+                break;
+            }
+            if(message[0] == 'R'){
+                locates.push_back(uint16_t(loadBigEndian<2>(message + 1)));
+            }
+        }
+        std::sort(locates.begin(), locates.end());
+        locates.erase(std::unique(locates.begin(), locates.end()), locates.end());
+        return locates;
+    }
+
+    // Locates listed later in the day fall into the last shard. With fewer symbols than shards the
+    // boundaries repeat and the surplus shards get empty ranges.
+    std::vector<ShardAssignment> planShards(){
+        std::vector<uint16_t> locates = listedLocates();
+        std::vector<ShardAssignment> shards(shardCount);
+        for(size_t i = 0; i < shardCount; i++){
+            shards[i] = ShardAssignment{uint32_t(i), uint32_t(shardCount), 1, UINT16_MAX, {}};
+            if(i > 0){
+                size_t first = i * locates.size() / shardCount;
+                shards[i].firstLocate = first < locates.size() ? locates[first] : UINT16_MAX;
+                shards[i - 1].lastLocate = shards[i].firstLocate - 1;
+            }
+        }
+        return shards;
+    }
+
+    // Reaps the local workers that have already exited, without blocking. Only a worker whose shard is
+    // empty may finish while others are still connecting; any other early exit is a worker that gave up
+    // connecting or crashed.
+    void reapExitedWorkers(){
+        for(auto it = children.begin(); it != children.end();){
+            int status = 0;
+            if(waitpid(*it, &status, WNOHANG) != *it){
+                ++it;
+                continue;
+            }
+            workerFailed = workerFailed || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            it = children.erase(it);
+        }
+    }
+
+    // Reaps the local workers, false when one of them failed.
+    bool waitForWorkers(){
+        bool ok = !workerFailed;
+        for(pid_t child : children){
+            int status = 0;
+            waitpid(child, &status, 0);
+            ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        children.clear();
+        workerFailed = false;
+        return ok;
+    }
+
+    // Next worker connection, or -1 once the deadline passes or a local worker has failed. The listen
+    // socket is polled in short slices so a local worker that died is noticed right away.
+    int acceptWorker(int listenFd, size_t connected, std::chrono::steady_clock::time_point deadline){
+        while(true){
+            reapExitedWorkers();
+            if(workerFailed){
+                std::cerr << "[ShardCoordinator] A local worker exited before the run finished, " << connected << " of "
+                          << shardCount << " workers connected" << std::endl;
+                return -1;
+            }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if(left <= 0){
+                std::cerr << "[ShardCoordinator] Only " << connected << " of " << shardCount << " workers connected within "
+                          << acceptTimeoutSeconds << " s" << std::endl;
+                return -1;
+            }
+            pollfd listener{listenFd, POLLIN, 0};
+            int ready = poll(&listener, 1, int(std::min<int64_t>(left, 100)));
+            if(ready > 0){
+                return accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            }
+            if(ready < 0 && errno != EINTR){
+                return -1;
+            }
+        }
+    }
+
+    public:
+    // Workers that have not all connected within acceptTimeoutSeconds fail the run.
+    ShardCoordinator(std::string filePath, std::string address, size_t shardCount, std::string finalVWAPFilePath, int acceptTimeoutSeconds = 60)
+        : filePath(filePath), address(address), finalVWAPFilePath(finalVWAPFilePath), shardCount(std::max<size_t>(shardCount, 1)),
+          acceptTimeoutSeconds(acceptTimeoutSeconds) {}
+
+    // Forks shardCount local workers. On a host with several NUMA nodes the workers are pinned to the
+    // nodes round robin, so each one's state is first touched, and kept, in its node's memory.
+    void spawnLocalWorkers(){
+        std::vector<std::vector<int>> nodes = numaNodeCpus();
+        for(size_t i = 0; i < shardCount; i++){
+            std::cout.flush();
+            pid_t pid = fork();
+            if(pid < 0){
+                std::cerr << "[ShardCoordinator] fork failed, " << i << " of " << shardCount << " workers started" << std::endl;
+                return;
+            }
+            if(pid == 0){
+                const std::vector<int>& cpus = nodes[i % nodes.size()];
+                if(!cpus.empty()){
+                    cpu_set_t mask;
+                    CPU_ZERO(&mask);
+                    for(int cpu : cpus){
+                        CPU_SET(cpu, &mask);
+                    }
+                    sched_setaffinity(0, sizeof(mask), &mask);
+                }
+                _exit(runShardWorker(address, filePath));
+            }
+            children.push_back(pid);
+        }
+    }
+
+    // Assigns a shard to each of the first shardCount workers to connect, collects their results
+    // and writes the merged VWAP file. False when a worker fails, no output is written then.
+    bool run(){
+        ShardAddress listenAddress = ShardAddress::parse(address);
+        int listenFd = listenOn(listenAddress, int(shardCount));
+        if(listenFd < 0){
+            waitForWorkers();
+            return false;
+        }
+        std::vector<ShardAssignment> shards = planShards();
+
+        bool ok = true;
+        std::vector<int> workers;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(acceptTimeoutSeconds);
+        for(size_t i = 0; i < shardCount && ok; i++){
+            int workerFd = acceptWorker(listenFd, i, deadline);
+            char magic[sizeof(shardMagic)];
+            ok = workerFd >= 0 && recvAll(workerFd, magic, sizeof(magic)) && std::memcmp(magic, shardMagic, sizeof(magic)) == 0
+                 && sendAll(workerFd, &shards[i], sizeof(ShardAssignment));
+            if(workerFd >= 0){
+                workers.push_back(workerFd);
+            }
+        }
+        close(listenFd);
+        if(!listenAddress.tcp){
+            unlink(listenAddress.path.c_str());
+        }
+
+        // Workers compute in parallel, their results wait in the socket buffers until read in shard order.
+        std::vector<std::vector<VWAPRecord>> results(workers.size());
+        for(size_t i = 0; i < workers.size() && ok; i++){
+            ShardResult result;
+            ok = recvAll(workers[i], &result, sizeof(result));
+            if(ok){
+                results[i].resize(result.recordCount);
+                ok = recvAll(workers[i], results[i].data(), result.recordCount * sizeof(VWAPRecord));
+                std::cout << "[shard] " << i << " locates " << shards[i].firstLocate << "-" << shards[i].lastLocate << ": "
+                          << result.recordCount << " rows in " << result.elapsedMicros / 1000 << " ms" << std::endl;
+            }
+        }
+        for(int workerFd : workers){
+            close(workerFd);
+        }
+        ok = waitForWorkers() && ok;
+        if(!ok){
+            std::cerr << "[ShardCoordinator] A worker failed, no VWAP output written" << std::endl;
+            return false;
+        }
+
+        std::ofstream finVWAP;
+        finVWAP.open(finalVWAPFilePath);
+        finVWAP << VWAPRecord::csvHeader();
+        for(auto& shardRecords : results){
+            for(auto& record : shardRecords){
+                finVWAP << symbolString(record.name) << "," << record.hour << "," << record.vwap << ",\n";
+            }
+        }
+        return true;
+    }
+};
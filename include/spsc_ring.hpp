@@ -0,0 +1,64 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+#endif
+
+#pragma once
+
+
+#include <vector>
+#include <atomic>
+#include <type_traits>
+#include <algorithm>
+
+
+// Single producer / single consumer ring buffer. Capacity is rounded up to a power of two,
+// head and tail live on their own cache lines and each side caches the other's index so the
+// shared counters are only re-read when the ring looks full or empty.
+template<typename Record>
+class SPSCRing{
+    static_assert(std::is_trivially_copyable<Record>::value, "SPSCRing records must be trivially copyable");
+
+    std::vector<Record> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+
+    public:
+    SPSCRing(size_t capacity){
+        size_t size = 1;
+        while(size < capacity){
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool tryPush(const Record& record){
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if(currentTail - cachedHead == slots.size()){
+            cachedHead = head.load(std::memory_order_acquire);
+            if(currentTail - cachedHead == slots.size()){
+                return false;
+            }
+        }
+        slots[currentTail & mask] = record;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pops up to maxRecords into out, returns how many were popped.
+    size_t popBatch(Record* out, size_t maxRecords){
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if(cachedTail == currentHead){
+            cachedTail = tail.load(std::memory_order_acquire);
+        }
+        size_t count = std::min(cachedTail - currentHead, maxRecords);
+        for(size_t i = 0; i < count; i++){
+            out[i] = slots[(currentHead + i) & mask];
+        }
+        head.store(currentHead + count, std::memory_order_release);
+        return count;
+    }
+};
@@ -0,0 +1,134 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#endif
+
+#pragma once
+
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+
+
+// Thread pool with one task deque per worker. A worker runs its own tasks newest first and, once
+// its deque is empty, steals the oldest task of another worker, so a few long tasks (the most active
+// symbols) never leave the remaining workers idle while work is still queued elsewhere.
+class WorkStealingPool{
+
+    struct WorkerQueue{
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    size_t nextQueue = 0;
+
+    // Tasks sitting in a deque, and tasks submitted but not yet finished.
+    std::atomic<size_t> queuedTasks{0};
+    std::atomic<size_t> pendingTasks{0};
+    bool stopping = false;
+    std::mutex idleMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    bool tryPop(size_t self, std::function<void()>& task){
+        WorkerQueue& queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()){
+            return false;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool trySteal(size_t self, std::function<void()>& task){
+        for(size_t offset = 1; offset < queues.size(); offset++){
+            WorkerQueue& victim = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()){
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self){
+        std::function<void()> task;
+        while(true){
+            if(tryPop(self, task) || trySteal(self, task)){
+                queuedTasks.fetch_sub(1);
+                task();
+                task = nullptr;
+                if(pendingTasks.fetch_sub(1) == 1){
+                    std::lock_guard<std::mutex> lock(idleMutex);
+                    allDone.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idleMutex);
+            workAvailable.wait(lock, [this](){ return stopping || queuedTasks.load() > 0; });
+            if(stopping && queuedTasks.load() == 0){
+                return;
+            }
+        }
+    }
+
+    public:
+    WorkStealingPool(size_t numWorkers = 0){
+        if(numWorkers == 0){
+            numWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for(size_t i = 0; i < numWorkers; i++){
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for(size_t i = 0; i < numWorkers; i++){
+            workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    ~WorkStealingPool(){
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for(auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Tasks are dealt round robin over the worker deques, idle workers steal the rest.
+    void submit(std::function<void()> task){
+        pendingTasks.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            queuedTasks.fetch_add(1);
+        }
+        {
+            WorkerQueue& queue = *queues[nextQueue++ % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        workAvailable.notify_one();
+    }
+
+    // Blocks until every submitted task has finished.
+    void wait(){
+        std::unique_lock<std::mutex> lock(idleMutex);
+        allDone.wait(lock, [this](){ return pendingTasks.load() == 0; });
+    }
+};
@@ -0,0 +1,325 @@
+#ifndef TRADE_TAPE_HPP
+#define TRADE_TAPE_HPP
+#endif
+
+#pragma once
+
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory_resource>
+
+
+// A decoded trade. Prices are raw ITCH prices (1/10000 dollars).
+struct TapeTrade{
+    uint64_t timestamp;
+    uint64_t shares;
+    uint32_t price;
+    uint64_t matchNumber;
+};
+
+
+inline void writeVarint(std::pmr::vector<uint8_t>& bytes, uint64_t value){
+    while(value >= 0x80){
+        bytes.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    bytes.push_back(uint8_t(value));
+}
+
+inline uint64_t readVarint(const uint8_t*& p){
+    uint64_t value = *p & 0x7F;
+    int shift = 7;
+    while(*p++ & 0x80){
+        value |= uint64_t(*p & 0x7F) << shift;
+        shift += 7;
+    }
+    return value;
+}
+
+inline uint64_t zigzag(int64_t value){
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value){
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+// Share counts and price deltas are mostly whole lots (100 shares) and ticks (one cent, 100 raw price
+// units). The low bit tells whether the rest is counted in lots or in units, so a round lot of up to
+// 6300 shares or a move of up to 31 cents takes one byte.
+inline uint64_t packLots(uint64_t value, uint64_t lot){
+    return value % lot == 0 ? (value / lot) << 1 : value << 1 | 1;
+}
+
+inline uint64_t unpackLots(uint64_t packed, uint64_t lot){
+    return packed & 1 ? packed >> 1 : (packed >> 1) * lot;
+}
+
+inline uint64_t packTicks(int64_t delta, int64_t tick){
+    return delta % tick == 0 ? zigzag(delta / tick) << 1 : zigzag(delta) << 1 | 1;
+}
+
+inline int64_t unpackTicks(uint64_t packed, int64_t tick){
+    return packed & 1 ? unzigzag(packed >> 1) : unzigzag(packed >> 1) * tick;
+}
+
+
+// Compressed trades of one symbol in arrival order. Every trade is four varints: timestamp delta in
+// nanoseconds (wrapping, so the rare step back stays lossless), price delta in ticks, shares in lots (see packLots()), and match number delta
+// (zigzag). Timestamps stay exact because writeRawInfo() and the query engine report them; their deltas
+// take about 5 of the 8.6-9.2 bytes per trade measured on the generator's and the sample feeds.
+// Every checkpointInterval trades a checkpoint keeps the decoder state, which is the matchNumber index
+// used to find (and tombstone) broken trades without decoding the whole tape. The first block starts from
+// the zero state and needs no checkpoint, and the broken trade bitmap is only allocated by the first
+// break, so symbols with a handful of trades carry no fixed overhead. A trade whose match number does not
+// exceed every earlier one is also kept in a small out-of-order index, so the checkpoints stay searchable
+// by the running maximum and a lookup never decodes more than one block.
+class SymbolTape{
+    static constexpr size_t checkpointInterval = 256;
+    static constexpr uint64_t sharesPerLot = 100;
+    static constexpr int64_t priceTick = 100;
+
+    // Decoder state before the first trade of a block (shares are not delta coded).
+    struct Checkpoint{
+        uint32_t byteOffset;
+        uint32_t price;
+        uint64_t timestamp;
+        uint64_t matchNumber;
+        // Largest match number before this block
+        uint64_t maxMatchBefore;
+    };
+
+    std::pmr::vector<uint8_t> bytes;
+    // Blocks 1 and up, block 0 starts at the zero state
+    std::pmr::vector<Checkpoint> checkpoints;
+    // Empty until the first broken trade
+    std::pmr::vector<uint64_t> brokenBits;
+    // matchNumber -> index of the trades appended out of match number order
+    std::pmr::multimap<uint64_t, size_t> outOfOrder;
+    size_t tradeCount = 0;
+    size_t brokenCount = 0;
+    TapeTrade last{};
+    uint64_t maxMatch = 0;
+
+    static void decodeNext(const uint8_t*& p, TapeTrade& trade){
+        trade.timestamp += readVarint(p);
+        trade.price = uint32_t(int64_t(trade.price) + unpackTicks(readVarint(p), priceTick));
+        trade.shares = unpackLots(readVarint(p), sharesPerLot);
+        trade.matchNumber += unzigzag(readVarint(p));
+    }
+
+    bool isBroken(size_t index) const {
+        return index / 64 < brokenBits.size() && (brokenBits[index / 64] >> (index % 64)) & 1;
+    }
+
+    // Positions p and trade just before the first trade of block.
+    void seekBlock(size_t block, const uint8_t*& p, TapeTrade& trade) const {
+        if(block == 0){
+            p = bytes.data();
+            trade = TapeTrade{};
+            return;
+        }
+        const Checkpoint& checkpoint = checkpoints[block - 1];
+        p = bytes.data() + checkpoint.byteOffset;
+        trade = TapeTrade{checkpoint.timestamp, 0, checkpoint.price, checkpoint.matchNumber};
+    }
+
+    // Index of the trade with matchNumber, or tradeCount when there is none.
+    size_t find(uint64_t matchNumber, TapeTrade& found) const {
+        // Every new trade is looked up first, and its match number is usually above all stored ones.
+        if(tradeCount == 0 || matchNumber > maxMatch){
+            return tradeCount;
+        }
+        // In order trades raise the running maximum, so only the last block starting below matchNumber can hold one.
+        size_t block = size_t(std::partition_point(checkpoints.begin(), checkpoints.end(), [matchNumber](const Checkpoint& checkpoint){
+            return checkpoint.maxMatchBefore < matchNumber;
+        }) - checkpoints.begin());
+        const uint8_t* p;
+        TapeTrade trade;
+        seekBlock(block, p, trade);
+        size_t end = std::min(tradeCount, (block + 1) * checkpointInterval);
+        for(size_t index = block * checkpointInterval; index < end; index++){
+            decodeNext(p, trade);
+            if(trade.matchNumber == matchNumber && !isBroken(index)){
+                found = trade;
+                return index;
+            }
+        }
+        auto [first, last] = outOfOrder.equal_range(matchNumber);
+        for(auto entry = first; entry != last; ++entry){
+            if(!isBroken(entry->second)){
+                found = decodeAt(entry->second);
+                return entry->second;
+            }
+        }
+        return tradeCount;
+    }
+
+    TapeTrade decodeAt(size_t index) const {
+        size_t block = index / checkpointInterval;
+        const uint8_t* p;
+        TapeTrade trade;
+        seekBlock(block, p, trade);
+        for(size_t i = block * checkpointInterval; i <= index; i++){
+            decodeNext(p, trade);
+        }
+        return trade;
+    }
+
+    public:
+    SymbolTape(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : bytes(resource), checkpoints(resource), brokenBits(resource), outOfOrder(resource) {}
+
+    void append(const TapeTrade& trade){
+        if(tradeCount && tradeCount % checkpointInterval == 0){
+            checkpoints.push_back({uint32_t(bytes.size()), last.price, last.timestamp, last.matchNumber, maxMatch});
+        }
+        if(!brokenBits.empty() && tradeCount % 64 == 0){
+            brokenBits.push_back(0);
+        }
+        if(tradeCount && trade.matchNumber <= maxMatch){
+            outOfOrder.emplace(trade.matchNumber, tradeCount);
+        }
+        maxMatch = std::max(maxMatch, trade.matchNumber);
+        writeVarint(bytes, trade.timestamp - last.timestamp);
+        writeVarint(bytes, packTicks(int64_t(trade.price) - int64_t(last.price), priceTick));
+        writeVarint(bytes, packLots(trade.shares, sharesPerLot));
+        writeVarint(bytes, zigzag(int64_t(trade.matchNumber - last.matchNumber)));
+        last = trade;
+        tradeCount++;
+    }
+
+    bool contains(uint64_t matchNumber) const {
+        TapeTrade found;
+        return find(matchNumber, found) != tradeCount;
+    }
+
+    // Tombstones the trade with matchNumber, optionally returning it. False when it is not on the tape.
+    bool remove(uint64_t matchNumber, TapeTrade* removed = nullptr){
+        TapeTrade found;
+        size_t index = find(matchNumber, found);
+        if(index == tradeCount){
+            return false;
+        }
+        if(brokenBits.empty()){
+            brokenBits.resize((tradeCount + 63) / 64);
+        }
+        brokenBits[index / 64] |= uint64_t(1) << (index % 64);
+        brokenCount++;
+        if(removed){
+            *removed = found;
+        }
+        return true;
+    }
+
+    // Live (not broken) trades.
+    size_t size() const {
+        return tradeCount - brokenCount;
+    }
+
+    size_t byteSize() const {
+        return bytes.size() + checkpoints.size() * sizeof(Checkpoint) + brokenBits.size() * sizeof(uint64_t)
+               + outOfOrder.size() * (sizeof(std::pair<uint64_t, size_t>) + 4 * sizeof(void*));
+    }
+
+    // Sequential decoder over the live trades.
+    class Iterator{
+        const SymbolTape* tape;
+        const uint8_t* p;
+        size_t index;
+        TapeTrade trade{};
+
+        void skipBroken(){
+            while(index < tape->tradeCount && tape->isBroken(index)){
+                advance();
+            }
+        }
+
+        void advance(){
+            if(++index < tape->tradeCount){
+                decodeNext(p, trade);
+            }
+        }
+
+        public:
+        Iterator(const SymbolTape* tape, size_t index) : tape(tape), p(tape->bytes.data()), index(index) {
+            if(index < tape->tradeCount){
+                decodeNext(p, trade);
+                skipBroken();
+            }
+        }
+
+        const TapeTrade& operator*() const {
+            return trade;
+        }
+
+        Iterator& operator++(){
+            advance();
+            skipBroken();
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index != other.index;
+        }
+    };
+
+    Iterator begin() const {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const {
+        return Iterator(this, tradeCount);
+    }
+};
+
+
+// Per-symbol compressed trade store, a drop-in for keeping every trade in a map of Data rows.
+class TradeTape{
+    std::pmr::memory_resource* resource;
+    std::pmr::map<uint16_t, SymbolTape> symbols;
+
+    public:
+    TradeTape(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : resource(resource), symbols(resource) {}
+
+    void append(uint16_t stockLocate, const TapeTrade& trade){
+        symbols.try_emplace(stockLocate, resource).first->second.append(trade);
+    }
+
+    bool contains(uint16_t stockLocate, uint64_t matchNumber) const {
+        auto it = symbols.find(stockLocate);
+        return it != symbols.end() && it->second.contains(matchNumber);
+    }
+
+    bool remove(uint16_t stockLocate, uint64_t matchNumber, TapeTrade* removed = nullptr){
+        auto it = symbols.find(stockLocate);
+        return it != symbols.end() && it->second.remove(matchNumber, removed);
+    }
+
+    size_t size() const {
+        size_t trades = 0;
+        for(auto& [stockLocate, tape] : symbols){
+            trades += tape.size();
+        }
+        return trades;
+    }
+
+    double bytesPerTrade() const {
+        size_t bytes = 0, trades = 0;
+        for(auto& [stockLocate, tape] : symbols){
+            bytes += tape.byteSize();
+            trades += tape.size();
+        }
+        return trades ? double(bytes) / double(trades) : 0.0;
+    }
+
+    auto begin() const {
+        return symbols.begin();
+    }
+
+    auto end() const {
+        return symbols.end();
+    }
+};
@@ -4,6 +4,9 @@
 
 #pragma once
 #include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
 
 std::string rstrip(std::string string){
     std::string trimmedString;
@@ -32,6 +35,16 @@ uint64_t readBigEndianInteger(std::ifstream &file, int numBytes){
     return integer;
 }
 
+uint64_t readBigEndianInteger(const char* buffer, int numBytes){
+
+    uint64_t integer = 0;
+    for(int i = 0; i < numBytes; i++){
+        integer = (integer << 8) | (buffer[i] & 0xFF);
+    }
+
+    return integer;
+}
+
 std::string readStock(std::ifstream &file){
     std::string stockName = readString(file, 8);
     return rstrip(stockName);
@@ -42,4 +55,52 @@ uint16_t ceilDiv(uint64_t x, uint64_t y){
         return uint16_t(x/y +1);
     }
     return uint16_t(x/y);
-}
\ No newline at end of file
+}
+
+std::vector<std::string> splitString(const std::string& text, char delimiter){
+    std::vector<std::string> parts;
+    size_t start = 0, end;
+    while((end = text.find(delimiter, start)) != std::string::npos){
+        parts.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    parts.push_back(text.substr(start));
+    return parts;
+}
+
+// Parses a time of day given either as nanoseconds since midnight or as H[H]:MM[:SS[.fraction]].
+// Throws std::invalid_argument when text is neither.
+uint64_t parseTimeOfDay(const std::string& text){
+    auto digits = [&text](const std::string& field, size_t maxDigits){
+        if(field.empty() || field.size() > maxDigits || field.find_first_not_of("0123456789") != std::string::npos){
+            throw std::invalid_argument("Malformed time of day: " + text);
+        }
+        return std::stoull(field);
+    };
+    if(text.find(':') == std::string::npos){
+        return digits(text, 19);
+    }
+    std::vector<std::string> fields = splitString(text, ':');
+    if(fields.size() > 3){
+        throw std::invalid_argument("Malformed time of day: " + text);
+    }
+    uint64_t nanoseconds = 0;
+    if(fields.size() == 3){
+        size_t dot = fields[2].find('.');
+        if(dot != std::string::npos){
+            std::string fraction = fields[2].substr(dot + 1);
+            nanoseconds = digits(fraction, 9);
+            for(size_t i = fraction.size(); i < 9; i++){
+                nanoseconds *= 10;
+            }
+            fields[2].erase(dot);
+        }
+    }
+    uint64_t hours = digits(fields[0], 2);
+    uint64_t minutes = digits(fields[1], 2);
+    uint64_t seconds = fields.size() == 3 ? digits(fields[2], 2) : 0;
+    if(hours > 23 || minutes > 59 || seconds > 59 || (fields.size() > 1 && fields[1].size() != 2) || (fields.size() == 3 && fields[2].size() != 2)){
+        throw std::invalid_argument("Malformed time of day: " + text);
+    }
+    return ((hours * 60 + minutes) * 60 + seconds) * 1000000000ULL + nanoseconds;
+}
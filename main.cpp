@@ -1,12 +1,595 @@
 #include "include/parser.hpp"
+#include "include/batch.hpp"
+#include "include/query.hpp"
+#include "include/book_history.hpp"
+#include "include/scan.hpp"
+#include "include/shard.hpp"
+#include "include/generator.hpp"
+#include "include/segments.hpp"
+#include <memory>
+
+// Usage :
+//   bin/main [FILE] [--out VWAP_CSV] [--threads N] [--arena] [--compact-trades] [--pipeline] [--lookahead K] [--async | --async-binary] [--async-drop] [--bbo TAPE] [--bbo-conflate-us N]
+//            [--incremental HOURLY_CSV] [--snapshots SNAPSHOT_FILE] [--snapshot-interval-ms N] [--feed FILE]...
+//            [--follow] [--follow-idle-ms N] [--catch-up] [--catch-up-mb N] [--catch-up-lag-ms N] [--catch-up-conflate-us N] [--alloc-trace] [--alloc-warmup N] [--alloc-abort] [--live] [--live-interval-ms N]
+//            [--profile] [--export-raw DIR] [--export-memory-mb N] [--export-binary] [--cache] [--cache-dir DIR] [--cache-max-mb N] [--cache-full-hash]
+//                                                     single day file, optionally with background output writers, the BBO quote tape
+//                                                     and hourly results appended as each hour closes. Two or more --feed
+//                                                     files (e.g. Nasdaq, BX, PSX) are merged into one consolidated run.
+//                                                     --follow keeps reading a day file that is still being written.
+//                                                     --catch-up skips non-essential messages and conflates output while
+//                                                     --follow is more than --catch-up-mb (or --catch-up-lag-ms) behind.
+//                                                     --alloc-trace reports the hot path's allocations, build with -DITCH_ALLOC_TRACE.
+//                                                     --live answers "SYM[,SYM...]" or "*" from stdin with the running VWAP during the parse.
+//                                                     --profile reports hardware counters per stage (framing, decode, book, aggregation, output).
+//                                                     --export-raw writes raw trades and open orders sorted by symbol and time, sorting on disk
+//                                                     beyond --export-memory-mb
+//                                                     --cache reuses the results of an earlier run of the same file and settings
+//                                                     (default directory $XDG_CACHE_HOME/itch-vwap, evicted beyond --cache-max-mb)
+//   bin/main --batch [--out DIR] [--workers N] [--export-raw] [--export-memory-mb N] [--export-binary]
+//            [--cache] [--cache-dir DIR] [--cache-max-mb N] [--cache-full-hash] PATH...
+//                                                     every PATH is a day file or a directory of day files
+//   bin/main --query FILE                             parses once, then answers "SYM[,SYM...] T0 T1" window queries from stdin
+//   bin/main --scan FILE                              message type, byte and per-hour rate profile without parsing
+//   bin/main --shards N [--listen ADDRESS] [--no-spawn] [--accept-timeout SECONDS] [--out VWAP_CSV] FILE
+//                                                     splits FILE by stock locate across N worker processes and merges their
+//                                                     hourly VWAP. ADDRESS is unix:PATH (default) or tcp:HOST:PORT; with
+//                                                     --no-spawn the workers are started by hand, possibly on other hosts:
+//   bin/main --shard-worker ADDRESS FILE
+//   bin/main --generate OUT_FILE [--seed N] [--symbols N] [--messages N | --scale X] [--zipf S] [--lifetime-ms MS]
+//            [--execute R] [--cancel R] [--delete R] [--replace R] [--broken R] [--no-crosses]
+//                                                     deterministic synthetic ITCH 5.0 day file, --scale 1 is about a real day
+//   bin/main --demux FILE SEGMENT_FILE                 regroups FILE into one contiguous segment per stock locate
+//   bin/main --segments SEGMENT_FILE [--out VWAP_CSV] [--workers N] [--symbols SYM[,SYM...]]
+//                                                     hourly VWAP from a segment file, segments run in parallel
+//   bin/main --asof SNAPSHOT_FILE FILE                answers "SYM TIME [DEPTH]" book queries from stdin using a snapshot file
+int main(int argc, char* argv[]){
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if(!args.empty() && args[0] == "--batch"){
+        std::string outputDir = "batch_output";
+        size_t numWorkers = 0;
+        bool exportRaw = false;
+        size_t exportMemoryMB = 256;
+        OutputFormat exportFormat = OutputFormat::CSV;
+        bool useCache = false;
+        std::string cacheDir;
+        size_t cacheMaxMB = 1024;
+        bool cacheFullHash = false;
+        std::vector<std::string> inputs;
+        for(size_t i = 1; i < args.size(); i++){
+            if(args[i] == "--out" && i + 1 < args.size()){
+                outputDir = args[++i];
+            }
+            else if(args[i] == "--cache"){
+                useCache = true;
+            }
+            else if(args[i] == "--cache-dir" && i + 1 < args.size()){
+                useCache = true;
+                cacheDir = args[++i];
+            }
+            else if(args[i] == "--cache-max-mb" && i + 1 < args.size()){
+                cacheMaxMB = std::stoul(args[++i]);
+            }
+            else if(args[i] == "--cache-full-hash"){
+                cacheFullHash = true;
+            }
+            else if(args[i] == "--export-raw"){
+                exportRaw = true;
+            }
+            else if(args[i] == "--export-memory-mb" && i + 1 < args.size()){
+                exportMemoryMB = std::stoul(args[++i]);
+            }
+            else if(args[i] == "--export-binary"){
+                exportFormat = OutputFormat::Binary;
+            }
+            else if(args[i] == "--workers" && i + 1 < args.size()){
+                numWorkers = std::stoul(args[++i]);
+            }
+            else{
+                inputs.push_back(args[i]);
+            }
+        }
+        BatchRunner runner = BatchRunner(inputs, outputDir, numWorkers);
+        if(exportRaw){
+            runner.enableRawExport(exportMemoryMB << 20, exportFormat);
+        }
+        std::unique_ptr<ResultCache> cache;
+        if(useCache){
+            cache = std::make_unique<ResultCache>(cacheDir, uint64_t(cacheMaxMB) << 20, cacheFullHash);
+            runner.enableResultCache(cache.get());
+        }
+        runner.run();
+        return 0;
+    }
+
+    if(!args.empty() && args[0] == "--query" && args.size() > 1){
+        Parser parser = Parser(args[1]);
+        parser.enableCompactTrades();
+        parser.parse();
+        VWAPQueryEngine engine = VWAPQueryEngine(parser);
+
+        std::string line;
+        std::cout << "symbols,t0,t1,vwap,volume,trades," << std::endl;
+        while(std::getline(std::cin, line)){
+            std::vector<std::string> fields = splitString(line, ' ');
+            if(fields.size() != 3){
+                std::cerr << "Expected: SYM[,SYM...] T0 T1" << std::endl;
+                continue;
+            }
+            uint64_t t0, t1;
+            try{
+                t0 = parseTimeOfDay(fields[1]);
+                t1 = parseTimeOfDay(fields[2]);
+            }
+            catch(const std::logic_error&){
+                std::cerr << "Expected: SYM[,SYM...] T0 T1" << std::endl;
+                continue;
+            }
+            WindowStats stats = engine.query(splitString(fields[0], ','), t0, t1);
+            std::replace(fields[0].begin(), fields[0].end(), ',', '|');
+            std::cout << fields[0] << "," << fields[1] << "," << fields[2] << "," << stats.vwap << "," << stats.volume << "," << stats.tradeCount << "," << std::endl;
+        }
+        return 0;
+    }
+
+    if(!args.empty() && args[0] == "--scan" && args.size() > 1){
+        printScanReport(scanMessages(args[1]), std::cout);
+        return 0;
+    }
+
+    if(!args.empty() && args[0] == "--generate" && args.size() > 1){
+        GeneratorConfig config;
+        for(size_t i = 2; i < args.size(); i++){
+            bool hasValue = i + 1 < args.size();
+            if(args[i] == "--seed" && hasValue){
+                config.seed = std::stoull(args[++i]);
+            }
+            else if(args[i] == "--symbols" && hasValue){
+                config.symbols = std::stoul(args[++i]);
+            }
+            else if(args[i] == "--messages" && hasValue){
+                config.messages = std::stoull(args[++i]);
+            }
+            else if(args[i] == "--scale" && hasValue){
+                double scale = std::stod(args[++i]);
+                if(scale > 10.0){
+                    std::cerr << "[ItchGenerator] --scale is limited to 10 days" << std::endl;
+                    scale = 10.0;
+                }
+                config.messages = uint64_t(scale * referenceDayMessages);
+            }
+            else if(args[i] == "--zipf" && hasValue){
+                config.zipfExponent = std::stod(args[++i]);
+            }
+            else if(args[i] == "--lifetime-ms" && hasValue){
+                config.meanOrderLifetimeMillis = std::stod(args[++i]);
+            }
+            else if(args[i] == "--execute" && hasValue){
+                config.executeRatio = std::stod(args[++i]);
+            }
+            else if(args[i] == "--cancel" && hasValue){
+                config.cancelRatio = std::stod(args[++i]);
+            }
+            else if(args[i] == "--delete" && hasValue){
+                config.deleteRatio = std::stod(args[++i]);
+            }
+            else if(args[i] == "--replace" && hasValue){
+                config.replaceRatio = std::stod(args[++i]);
+            }
+            else if(args[i] == "--broken" && hasValue){
+                config.brokenTradeRatio = std::stod(args[++i]);
+            }
+            else if(args[i] == "--no-crosses"){
+                config.crosses = false;
+            }
+            else{
+                std::cerr << "[ItchGenerator] Unknown option " << args[i] << std::endl;
+                return 1;
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        ItchGenerator generator = ItchGenerator(config);
+        uint64_t messages = generator.write(args[1]);
+        std::cout << "[generate] " << messages << " messages -> " << args[1] << " in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+        return messages ? 0 : 1;
+    }
+
+    if(!args.empty() && args[0] == "--demux" && args.size() > 2){
+        size_t segments = demuxSegments(args[1], args[2]);
+        std::cout << "[demux] " << segments << " segments -> " << args[2] << std::endl;
+        return segments ? 0 : 1;
+    }
+
+    if(!args.empty() && args[0] == "--segments" && args.size() > 1){
+        std::string outputPath = "/workspaces/itch-5.0-processing/itch_vwap.csv";
+        size_t numWorkers = 0;
+        std::vector<std::string> symbols;
+        for(size_t i = 2; i < args.size(); i++){
+            if(args[i] == "--out" && i + 1 < args.size()){
+                outputPath = args[++i];
+            }
+            else if(args[i] == "--workers" && i + 1 < args.size()){
+                numWorkers = std::stoul(args[++i]);
+            }
+            else if(args[i] == "--symbols" && i + 1 < args.size()){
+                symbols = splitString(args[++i], ',');
+            }
+        }
+        SegmentRunner runner = SegmentRunner(args[1], outputPath, numWorkers, symbols);
+        runner.run();
+        return 0;
+    }
+
+    if(!args.empty() && args[0] == "--shard-worker" && args.size() > 2){
+        return runShardWorker(args[1], args[2]);
+    }
+
+    if(!args.empty() && args[0] == "--shards" && args.size() > 2){
+        size_t shardCount = std::stoul(args[1]);
+        std::string address = "unix:/tmp/itch_shards_" + std::to_string(getpid()) + ".sock";
+        std::string outputPath = "/workspaces/itch-5.0-processing/itch_vwap.csv";
+        std::string inputPath = "/workspaces/itch-5.0-processing/01302019.NASDAQ_ITCH50";
+        bool spawnWorkers = true;
+        int acceptTimeoutSeconds = 60;
+        for(size_t i = 2; i < args.size(); i++){
+            if(args[i] == "--listen" && i + 1 < args.size()){
+                address = args[++i];
+            }
+            else if(args[i] == "--accept-timeout" && i + 1 < args.size()){
+                acceptTimeoutSeconds = std::stoi(args[++i]);
+            }
+            else if(args[i] == "--out" && i + 1 < args.size()){
+                outputPath = args[++i];
+            }
+            else if(args[i] == "--no-spawn"){
+                spawnWorkers = false;
+            }
+            else{
+                inputPath = args[i];
+            }
+        }
+        ShardCoordinator coordinator = ShardCoordinator(inputPath, address, shardCount, outputPath, acceptTimeoutSeconds);
+        if(spawnWorkers){
+            coordinator.spawnLocalWorkers();
+        }
+        return coordinator.run() ? 0 : 1;
+    }
+
+    if(!args.empty() && args[0] == "--asof" && args.size() > 2){
+        BookHistory history = BookHistory(args[1], args[2]);
+
+        std::string line;
+        std::cout << "symbol,time,side,price,shares,orders," << std::endl;
+        while(std::getline(std::cin, line)){
+            std::vector<std::string> fields = splitString(line, ' ');
+            if(fields.size() != 2 && fields.size() != 3){
+                std::cerr << "Expected: SYM TIME [DEPTH]" << std::endl;
+                continue;
+            }
+            uint16_t stockLocate = history.locate(fields[0]);
+            if(stockLocate == 0){
+                std::cerr << "[BookHistory] Symbol " << fields[0] << " not found!" << std::endl;
+                continue;
+            }
+            uint64_t timestamp;
+            size_t depth;
+            try{
+                timestamp = parseTimeOfDay(fields[1]);
+                depth = fields.size() == 3 ? std::stoul(fields[2]) : 0;
+            }
+            catch(const std::logic_error&){
+                std::cerr << "Expected: SYM TIME [DEPTH]" << std::endl;
+                continue;
+            }
+            BookAsOf book = history.asOf(stockLocate, timestamp, depth);
+            for(auto& level : book.bids){
+                std::cout << fields[0] << "," << fields[1] << ",B," << level.price / 10000.0 << "," << level.shares << "," << level.orders << "," << std::endl;
+            }
+            for(auto& level : book.asks){
+                std::cout << fields[0] << "," << fields[1] << ",S," << level.price / 10000.0 << "," << level.shares << "," << level.orders << "," << std::endl;
+            }
+        }
+        return 0;
+    }
 
-int main(){
     std::string binary_file = "/workspaces/itch-5.0-processing/01302019.NASDAQ_ITCH50";
-    Parser parser = Parser(binary_file);
+    std::string vwapFile = "/workspaces/itch-5.0-processing/itch_vwap.csv";
+    std::string bboTapeFile;
+    std::string incrementalFile;
+    std::vector<std::string> feeds;
+    bool followFile = false;
+    bool liveQueries = false;
+    bool profileStages = false;
+    std::string exportDir;
+    size_t exportMemoryMB = 256;
+    OutputFormat exportFormat = OutputFormat::CSV;
+    bool useCache = false;
+    std::string cacheDir;
+    size_t cacheMaxMB = 1024;
+    bool cacheFullHash = false;
+    uint64_t liveIntervalMillis = 100;
+    bool traceAllocations = false;
+    bool abortOnAllocation = false;
+    uint64_t allocationWarmup = 1000000;
+    size_t lookaheadDepth = 0;
+    uint64_t followIdleMillis = 0;
+    bool catchUpMode = false;
+    size_t catchUpMB = 64;
+    uint64_t catchUpLagMillis = 0;
+    uint64_t catchUpConflationMicros = 1000000;
+    std::string snapshotFile;
+    uint64_t snapshotIntervalMillis = 1000;
+    uint64_t bboConflationMicros = 0;
+    bool asyncOutput = false;
+    bool useArena = false;
+    bool compactTrades = false;
+    bool pipelined = false;
+    size_t numThreads = 0;
+    OutputFormat outputFormat = OutputFormat::CSV;
+    BackpressurePolicy backpressurePolicy = BackpressurePolicy::Block;
+    for(size_t i = 0; i < args.size(); i++){
+        if(args[i] == "--out" && i + 1 < args.size()){
+            vwapFile = args[++i];
+        }
+        else if(args[i] == "--threads" && i + 1 < args.size()){
+            numThreads = std::stoul(args[++i]);
+        }
+        else if(args[i] == "--compact-trades"){
+            compactTrades = true;
+        }
+        else if(args[i] == "--pipeline"){
+            pipelined = true;
+        }
+        else if(args[i] == "--arena"){
+            useArena = true;
+        }
+        else if(args[i] == "--async"){
+            asyncOutput = true;
+        }
+        else if(args[i] == "--async-binary"){
+            asyncOutput = true;
+            outputFormat = OutputFormat::Binary;
+        }
+        else if(args[i] == "--async-drop"){
+            asyncOutput = true;
+            backpressurePolicy = BackpressurePolicy::Drop;
+        }
+        else if(args[i] == "--incremental" && i + 1 < args.size()){
+            incrementalFile = args[++i];
+        }
+        else if(args[i] == "--lookahead" && i + 1 < args.size()){
+            lookaheadDepth = std::stoul(args[++i]);
+        }
+        else if(args[i] == "--follow"){
+            followFile = true;
+        }
+        else if(args[i] == "--follow-idle-ms" && i + 1 < args.size()){
+            followIdleMillis = std::stoull(args[++i]);
+        }
+        else if(args[i] == "--catch-up"){
+            catchUpMode = true;
+        }
+        else if(args[i] == "--catch-up-mb" && i + 1 < args.size()){
+            catchUpMode = true;
+            catchUpMB = std::stoul(args[++i]);
+        }
+        else if(args[i] == "--catch-up-lag-ms" && i + 1 < args.size()){
+            catchUpMode = true;
+            catchUpLagMillis = std::stoull(args[++i]);
+        }
+        else if(args[i] == "--catch-up-conflate-us" && i + 1 < args.size()){
+            catchUpConflationMicros = std::stoull(args[++i]);
+        }
+        else if(args[i] == "--export-raw" && i + 1 < args.size()){
+            exportDir = args[++i];
+        }
+        else if(args[i] == "--export-memory-mb" && i + 1 < args.size()){
+            exportMemoryMB = std::stoul(args[++i]);
+        }
+        else if(args[i] == "--export-binary"){
+            exportFormat = OutputFormat::Binary;
+        }
+        else if(args[i] == "--profile"){
+            profileStages = true;
+        }
+        else if(args[i] == "--cache"){
+            useCache = true;
+        }
+        else if(args[i] == "--cache-dir" && i + 1 < args.size()){
+            useCache = true;
+            cacheDir = args[++i];
+        }
+        else if(args[i] == "--cache-max-mb" && i + 1 < args.size()){
+            cacheMaxMB = std::stoul(args[++i]);
+        }
+        else if(args[i] == "--cache-full-hash"){
+            cacheFullHash = true;
+        }
+        else if(args[i] == "--live"){
+            liveQueries = true;
+        }
+        else if(args[i] == "--live-interval-ms" && i + 1 < args.size()){
+            liveIntervalMillis = std::stoull(args[++i]);
+        }
+        else if(args[i] == "--alloc-trace"){
+            traceAllocations = true;
+        }
+        else if(args[i] == "--alloc-warmup" && i + 1 < args.size()){
+            allocationWarmup = std::stoull(args[++i]);
+        }
+        else if(args[i] == "--alloc-abort"){
+            traceAllocations = true;
+            abortOnAllocation = true;
+        }
+        else if(args[i] == "--feed" && i + 1 < args.size()){
+            feeds.push_back(args[++i]);
+        }
+        else if(args[i] == "--snapshots" && i + 1 < args.size()){
+            snapshotFile = args[++i];
+        }
+        else if(args[i] == "--snapshot-interval-ms" && i + 1 < args.size()){
+            snapshotIntervalMillis = std::stoull(args[++i]);
+        }
+        else if(args[i] == "--bbo" && i + 1 < args.size()){
+            bboTapeFile = args[++i];
+        }
+        else if(args[i] == "--bbo-conflate-us" && i + 1 < args.size()){
+            bboConflationMicros = std::stoull(args[++i]);
+        }
+        else{
+            binary_file = args[i];
+        }
+    }
+
+    ParserArena arena;
+    Parser parser = Parser(binary_file, vwapFile, useArena ? static_cast<std::pmr::memory_resource*>(&arena) : std::pmr::get_default_resource());
+    if(asyncOutput){
+        parser.enableAsyncOutput(outputFormat, backpressurePolicy);
+    }
+    if(compactTrades){
+        parser.enableCompactTrades();
+    }
+    if(pipelined){
+        parser.enablePipelinedDecode();
+    }
+    if(lookaheadDepth > 0){
+        parser.enableLookahead(lookaheadDepth);
+    }
+    if(!incrementalFile.empty()){
+        parser.enableIncrementalOutput(incrementalFile);
+    }
+    std::unique_ptr<WorkStealingPool> pool;
+    if(numThreads > 0){
+        pool = std::make_unique<WorkStealingPool>(numThreads);
+        parser.setWorkerPool(pool.get());
+    }
+    std::unique_ptr<BBOTracker> bbo;
+    if(!bboTapeFile.empty()){
+        bbo = std::make_unique<BBOTracker>(bboTapeFile, bboConflationMicros);
+        parser.setBBOTracker(bbo.get());
+    }
+    std::unique_ptr<BookSnapshotWriter> snapshots;
+    if(!snapshotFile.empty()){
+        snapshots = std::make_unique<BookSnapshotWriter>(snapshotFile, snapshotIntervalMillis * 1000);
+        parser.setBookSnapshots(snapshots.get());
+    }
+    std::unique_ptr<StageProfiler> profiler;
+    if(profileStages){
+        if(followFile || !feeds.empty()){
+            std::cerr << "[StageProfiler] Only single file runs can be profiled" << std::endl;
+            return 1;
+        }
+        profiler = std::make_unique<StageProfiler>();
+        parser.setStageProfiler(profiler.get());
+    }
+    std::unique_ptr<CatchUpMonitor> catchUp;
+    if(catchUpMode){
+        if(!followFile){
+            std::cerr << "[CatchUp] Catch-up mode needs --follow" << std::endl;
+            return 1;
+        }
+        catchUp = std::make_unique<CatchUpMonitor>(uint64_t(catchUpMB) << 20, catchUpLagMillis, catchUpConflationMicros);
+        parser.setCatchUpMonitor(catchUp.get());
+    }
+    std::unique_ptr<LiveVWAP> live;
+    std::atomic<bool> parsing{true};
+    std::thread liveReader;
+    if(liveQueries){
+        live = std::make_unique<LiveVWAP>(liveIntervalMillis);
+        parser.setLiveVWAP(live.get());
+        std::cout << "sequence,symbol,timestamp,vwap,volume,trades," << std::endl;
+        liveReader = std::thread([&live, &parsing](){ answerLiveQueries(*live, parsing, STDIN_FILENO, std::cout); });
+    }
+
+    // Only plain runs of one file are cached: every other option has outputs or side effects of its own.
+    std::unique_ptr<ResultCache> cache;
+    std::string cacheKey;
+    if(useCache){
+        bool cacheable = feeds.empty() && !followFile && incrementalFile.empty() && bboTapeFile.empty() && snapshotFile.empty()
+                         && !liveQueries && exportDir.empty() && !profileStages && !traceAllocations
+                         && backpressurePolicy != BackpressurePolicy::Drop;
+        if(cacheable){
+            cache = std::make_unique<ResultCache>(cacheDir, uint64_t(cacheMaxMB) << 20, cacheFullHash);
+            cacheKey = cache->key(binary_file, parser.resultConfiguration() + (asyncOutput && outputFormat == OutputFormat::Binary ? " binary" : ""));
+        }
+        else{
+            std::cerr << "[ResultCache] Only plain single file runs are cached, running without the cache" << std::endl;
+        }
+    }
+    std::string resultFile = asyncOutput && outputFormat == OutputFormat::Binary ? std::filesystem::path(vwapFile).replace_extension(".bin").string() : vwapFile;
+    if(!cacheKey.empty()){
+        if(cache->loadFile(cacheKey, "vwap", resultFile)){
+            std::cout << "[cache] hit " << cacheKey << " -> " << resultFile << std::endl;
+            return 0;
+        }
+        std::vector<HourlyAggregate> aggregates;
+        if(cache->loadRecords(cacheKey, "aggregates", aggregates)){
+            parser.loadAggregates(aggregates);
+            parser.closeOutput();
+            cache->storeFile(cacheKey, "vwap", resultFile);
+            std::cout << "[cache] hit " << cacheKey << " (aggregates) -> " << resultFile << std::endl;
+            return 0;
+        }
+    }
 
-    parser.parse();
+    if(traceAllocations){
+        if(!allocationTracingBuiltIn){
+            std::cerr << "[AllocationTracer] Not built in, rebuild with -DITCH_ALLOC_TRACE" << std::endl;
+            return 1;
+        }
+        allocationTracer.enable(allocationWarmup, abortOnAllocation);
+    }
+    bool parsed = true;
+    if(!feeds.empty()){
+        parsed = parser.parseMerged(feeds);
+    }
+    else if(followFile){
+        parser.follow(followIdleMillis);
+    }
+    else{
+        parser.parse();
+    }
+    if(traceAllocations){
+        allocationTracer.report(std::cerr);
+    }
+    if(catchUp){
+        catchUp->report(std::cerr);
+    }
+    if(liveReader.joinable()){
+        parsing = false;
+        liveReader.join();
+    }
+    if(!parsed){
+        return 1;
+    }
+    if(compactTrades){
+        const TradeTape& tape = parser.getTradeTape();
+        std::cout << "[compact-trades] " << tape.size() << " trades, " << tape.bytesPerTrade() << " bytes/trade" << std::endl;
+    }
     parser.processRunningVWAP();
+    if(!cacheKey.empty()){
+        parser.closeOutput();
+        cache->storeRecords(cacheKey, "aggregates", parser.hourlyAggregates());
+        cache->storeFile(cacheKey, "vwap", resultFile);
+        std::cout << "[cache] stored " << cacheKey << std::endl;
+    }
+    if(!exportDir.empty()){
+        std::filesystem::create_directories(exportDir);
+        std::string extension = exportFormat == OutputFormat::Binary ? ".bin" : ".csv";
+        RawExportSorter tradeExport((std::filesystem::path(exportDir) / "raw_trades").string(), exportMemoryMB << 20);
+        RawExportSorter orderExport((std::filesystem::path(exportDir) / "open_orders").string(), exportMemoryMB << 20);
+        parser.exportRawInfo(tradeExport, orderExport, exportDay(binary_file));
+        uint64_t trades = tradeExport.finish((std::filesystem::path(exportDir) / ("raw_trades" + extension)).string(), exportFormat);
+        uint64_t openOrders = orderExport.finish((std::filesystem::path(exportDir) / ("open_orders" + extension)).string(), exportFormat);
+        std::cout << "[export] " << trades << " trades, " << openOrders << " open orders -> " << exportDir << std::endl;
+    }
+    if(profiler){
+        profiler->stop();
+        profiler->report(std::cerr);
+    }
 
     return 0;
 
-}
\ No newline at end of file
+}